@@ -0,0 +1,297 @@
+#include "generate.hpp"
+
+#include "ndjson_load.hpp"
+#include "util.hpp"
+
+#include <octave/interpreter.h>
+#include <octave/ov.h>
+#include <simdjson.h>
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+static constexpr auto usage_string = R"(
+usage: ndjson_bench [options]
+
+options:
+    --shape <names>     Comma separated shapes to benchmark, defaults to all of them
+                        (wide, nested, numeric, logs, skewed).
+    --size <MiB>        Size of the input of each shape, defaults to 64.
+    --repeat <count>    Number of runs of each phase, the fastest is reported. Defaults to 3.
+    --threads <count>   Number of threads of the multi-threaded phases, defaults to the same
+                        as the Octave functions.
+    --seed <number>     Seed of the generators, defaults to 42.
+    --generate <shape>  Write the input of a shape to stdout instead of benchmarking.
+    --help              Show this message.
+)";
+
+namespace octave_ndjson::bench::detail
+{
+    struct Config
+    {
+        std::vector<Shape>   m_shapes   = { all_shapes().begin(), all_shapes().end() };
+        std::size_t          m_bytes    = 64ul * 1024 * 1024;
+        std::size_t          m_repeat   = 3;
+        std::size_t          m_threads  = 0;
+        std::uint64_t        m_seed     = 42;
+        std::optional<Shape> m_generate = std::nullopt;
+    };
+
+    /**
+     * @brief A way to load the input, each phase is timed separately.
+     */
+    struct Phase
+    {
+        std::string_view m_name;
+        bool             m_multi;
+        Options          m_options;
+    };
+
+    struct Measure
+    {
+        double      m_seconds;
+        std::size_t m_peak_rss;    // in bytes
+    };
+
+    std::size_t parse_number(std::string_view option, std::string_view value)
+    {
+        auto number = 0ul;
+        auto end    = value.data() + value.size();
+
+        if (auto [ptr, ec] = std::from_chars(value.data(), end, number); ec != std::errc{} or ptr != end) {
+            throw std::invalid_argument{ std::format("Invalid value '{}' for '{}'", value, option) };
+        }
+        return number;
+    }
+
+    Shape parse_shape(std::string_view value)
+    {
+        if (auto shape = shape_from_string(value)) {
+            return *shape;
+        }
+        throw std::invalid_argument{ std::format("Unknown shape '{}'", value) };
+    }
+
+    /**
+     * @brief Parse the command line.
+     *
+     * @return The config, or `std::nullopt` if the help is requested.
+     *
+     * @throw std::invalid_argument on unknown option or invalid value.
+     */
+    std::optional<Config> parse_args(int argc, char** argv)
+    {
+        auto config = Config{};
+
+        for (auto i = 1; i < argc; ++i) {
+            auto option = std::string_view{ argv[i] };
+            if (option == "--help") {
+                return std::nullopt;
+            } else if (i + 1 >= argc) {
+                throw std::invalid_argument{ std::format("Expected a value for '{}'", option) };
+            }
+
+            auto value = std::string_view{ argv[++i] };
+            if (option == "--shape") {
+                auto splitter = util::StringSplitter{ value, ',' };
+                config.m_shapes.clear();
+                while (auto name = splitter.next()) {
+                    config.m_shapes.push_back(parse_shape(*name));
+                }
+            } else if (option == "--size") {
+                config.m_bytes = parse_number(option, value) * 1024 * 1024;
+            } else if (option == "--repeat") {
+                config.m_repeat = std::max(parse_number(option, value), 1ul);
+            } else if (option == "--threads") {
+                config.m_threads = parse_number(option, value);
+            } else if (option == "--seed") {
+                config.m_seed = parse_number(option, value);
+            } else if (option == "--generate") {
+                config.m_generate = parse_shape(value);
+            } else {
+                throw std::invalid_argument{ std::format("Unknown option '{}'", option) };
+            }
+        }
+
+        return config;
+    }
+
+    std::vector<Phase> phases(std::size_t threads)
+    {
+        auto options = [&](ParseMode mode, Layout layout, Backend backend) {
+            return Options{
+                .m_mode       = mode,
+                .m_layout     = layout,
+                .m_backend    = backend,
+                .m_numeric    = Numeric::Double,
+                .m_threads    = threads,
+                .m_batch_size = simdjson::dom::DEFAULT_BATCH_SIZE,
+                .m_progress   = false,
+                .m_stats      = nullptr,
+                .m_fields     = std::nullopt,
+                .m_where      = std::nullopt,
+            };
+        };
+
+        using M = ParseMode;
+        using L = Layout;
+        using B = Backend;
+
+        // clang-format off
+        return {
+            { "load",                  false, options(M::Relaxed, L::Rows,     B::Dom)      },
+            { "load ondemand",         false, options(M::Relaxed, L::Rows,     B::OnDemand) },
+            { "load_multi",            true,  options(M::Relaxed, L::Rows,     B::Dom)      },
+            { "load_multi ondemand",   true,  options(M::Relaxed, L::Rows,     B::OnDemand) },
+            { "load_multi strict",     true,  options(M::Strict,  L::Rows,     B::Dom)      },
+            { "load_multi columnar",   true,  options(M::Strict,  L::Columnar, B::Dom)      },
+            { "load_multi union",      true,  options(M::Union,   L::Rows,     B::Dom)      },
+        };
+        // clang-format on
+    }
+
+    /**
+     * @brief Reset the peak RSS of the process to its current RSS (Linux only).
+     *
+     * @return Whether the peak was reset, the peak of the phases is the peak of the process otherwise.
+     */
+    bool reset_peak_rss()
+    {
+        auto file = std::ofstream{ "/proc/self/clear_refs" };
+        return static_cast<bool>(file << "5" << std::flush);
+    }
+
+    /**
+     * @brief Get the peak RSS since the last reset (or since the start of the process).
+     */
+    std::size_t peak_rss()
+    {
+        auto file = std::ifstream{ "/proc/self/status" };
+        for (auto line = std::string{}; std::getline(file, line);) {
+            if (line.starts_with("VmHWM:")) {
+                auto begin = line.find_first_of("0123456789");
+                auto end   = line.find_first_not_of("0123456789", begin);
+                return parse_number("VmHWM", std::string_view{ line }.substr(begin, end - begin)) * 1024;
+            }
+        }
+
+        auto usage = rusage{};
+        getrusage(RUSAGE_SELF, &usage);
+        return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+    }
+
+    /**
+     * @brief Run a phase `repeat` times.
+     *
+     * @return The fastest run and the highest peak RSS of all runs.
+     *
+     * @throw <internal_octave_error> if the input can't be loaded in this phase.
+     */
+    Measure run(const Phase& phase, simdjson::padded_string_view input, std::size_t repeat)
+    {
+        auto measure = Measure{ .m_seconds = std::numeric_limits<double>::infinity(), .m_peak_rss = 0 };
+
+        for (auto i = 0ul; i < repeat; ++i) {
+            reset_peak_rss();
+
+            auto start = std::chrono::steady_clock::now();
+
+            // the result is destroyed after the peak is read, so it's part of the peak
+            [[maybe_unused]] auto result = phase.m_multi ? load_multi(input, phase.m_options)
+                                                         : load(input, phase.m_options);
+
+            auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            measure.m_seconds  = std::min(measure.m_seconds, seconds);
+            measure.m_peak_rss = std::max(measure.m_peak_rss, peak_rss());
+        }
+
+        return measure;
+    }
+
+    void benchmark(const Config& config)
+    {
+        auto line = [](auto shape, auto phase, auto mb_per_sec, auto docs_per_sec, auto peak, auto seconds) {
+            std::cout << std::format(
+                "{:<8} {:<22} {:>10} {:>14} {:>12} {:>10}\n",
+                shape,
+                phase,
+                mb_per_sec,
+                docs_per_sec,
+                peak,
+                seconds
+            );
+        };
+
+        line("shape", "phase", "MB/s", "docs/s", "peak RSS", "time");
+
+        for (auto shape : config.m_shapes) {
+            auto input = simdjson::padded_string{ generate(shape, config.m_bytes, config.m_seed) };
+            auto docs  = util::count_split({ input.data(), input.size() }, '\n');
+            auto bytes = static_cast<double>(input.size());
+
+            for (const auto& phase : phases(config.m_threads)) {
+                try {
+                    auto [seconds, peak] = run(phase, input, config.m_repeat);
+                    line(
+                        to_string(shape),
+                        phase.m_name,
+                        std::format("{:.1f}", bytes / seconds / 1e6),
+                        std::format("{:.0f}", static_cast<double>(docs) / seconds),
+                        std::format("{:.1f} MiB", static_cast<double>(peak) / (1024.0 * 1024.0)),
+                        std::format("{:.3f}s", seconds)
+                    );
+                } catch (const std::exception& e) {
+                    auto what = std::string_view{ e.what() };
+                    line(to_string(shape), phase.m_name, "failed:", what.substr(0, what.find('\n')), "", "");
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    namespace bench = octave_ndjson::bench;
+
+    auto config = std::optional<bench::detail::Config>{};
+    try {
+        config = bench::detail::parse_args(argc, argv);
+    } catch (const std::invalid_argument& e) {
+        std::cerr << e.what() << '\n' << usage_string;
+        return 1;
+    }
+
+    if (not config.has_value()) {
+        std::cout << usage_string;
+        return 0;
+    } else if (config->m_generate.has_value()) {
+        std::cout << bench::generate(*config->m_generate, config->m_bytes, config->m_seed);
+        return 0;
+    }
+
+    // the load functions report the errors through `error`, which needs a running interpreter
+    auto interpreter = octave::interpreter{};
+    interpreter.initialize_history(false);
+    interpreter.initialize_load_path(false);
+
+    if (interpreter.execute() != 0) {
+        std::cerr << "Failed to start the Octave interpreter\n";
+        return 1;
+    }
+
+    bench::detail::benchmark(*config);
+}
@@ -0,0 +1,57 @@
+% Benchmark of the Octave functions on the synthetic inputs of `ndjson_bench`.
+%
+% Run it from the build directory, where the .oct files and `ndjson_bench` are (build it with the `bench`
+% target first), e.g. `octave --eval "run('../bench/bench.m')"`. The inputs are generated in the temporary
+% directory and removed at the end.
+
+shapes  = {'wide', 'nested', 'numeric', 'logs', 'skewed'};
+size_mb = 64;
+repeat  = 3;
+
+function seconds = measure(fn, repeat)
+  seconds = Inf;
+  for i = 1:repeat
+    start   = tic();
+    result  = fn();
+    seconds = min(seconds, toc(start));
+  end
+end
+
+function report(shape, name, bytes, docs, seconds)
+  printf("%-8s %-34s %10.1f %14.0f %10.3fs\n", shape, name, bytes / seconds / 1e6, docs / seconds, seconds);
+end
+
+printf("%-8s %-34s %10s %14s %11s\n", "shape", "function", "MB/s", "docs/s", "time");
+
+for i = 1:numel(shapes)
+  shape = shapes{i};
+  path  = [tempname() '.jsonl'];
+
+  status = system(sprintf('./ndjson_bench --generate %s --size %d > %s', shape, size_mb, path));
+  if status != 0
+    error('failed to generate the input of shape %s', shape);
+  end
+
+  string = fileread(path);
+  bytes  = numel(string);
+  docs   = sum(string == "\n");
+
+  cases = {
+    'ndjson_load_string (single)',   @() ndjson_load_string(string, 'threading', 'single', 'mode', 'relaxed');
+    'ndjson_load_string (multi)',    @() ndjson_load_string(string, 'threading', 'multi', 'mode', 'relaxed');
+    'ndjson_load_file (single)',     @() ndjson_load_file(path, 'threading', 'single', 'mode', 'relaxed');
+    'ndjson_load_file (multi)',      @() ndjson_load_file(path, 'threading', 'multi', 'mode', 'relaxed');
+    'ndjson_load_file (columnar)',   @() ndjson_load_file(path, 'layout', 'columnar');
+    'jsondecode (as a JSON array)',  @() jsondecode(['[' strrep(strtrim(string), "\n", ',') ']']);
+  };
+
+  for j = 1:rows(cases)
+    try
+      report(shape, cases{j, 1}, bytes, docs, measure(cases{j, 2}, repeat));
+    catch err
+      printf("%-8s %-34s failed: %s\n", shape, cases{j, 1}, strtok(err.message, "\n"));
+    end
+  end
+
+  delete(path);
+end
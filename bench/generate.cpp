@@ -0,0 +1,198 @@
+#include "generate.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <format>
+#include <iterator>
+#include <random>
+
+namespace octave_ndjson::bench::detail
+{
+    constexpr auto shapes = std::array{
+        Shape::Wide, Shape::Nested, Shape::Numeric, Shape::Logs, Shape::Skewed,
+    };
+
+    constexpr auto words = std::array{
+        "request", "response", "user",  "session", "timeout", "connection", "cache",   "miss",
+        "hit",     "retry",    "error", "warning", "started", "finished",   "payload", "queue",
+    };
+
+    constexpr auto levels = std::array{ "DEBUG", "INFO", "INFO", "INFO", "WARN", "ERROR" };
+
+    using Random = std::mt19937_64;
+
+    /**
+     * @brief Append a random lowercase identifier.
+     */
+    void append_identifier(std::string& out, Random& random, std::size_t size)
+    {
+        auto letter = std::uniform_int_distribution<int>{ 'a', 'z' };
+        for (auto i = 0ul; i < size; ++i) {
+            out.push_back(static_cast<char>(letter(random)));
+        }
+    }
+
+    /**
+     * @brief Append a sentence of random words, at least `size` characters long.
+     */
+    void append_sentence(std::string& out, Random& random, std::size_t size)
+    {
+        auto word  = std::uniform_int_distribution<std::size_t>{ 0, words.size() - 1 };
+        auto start = out.size();
+
+        while (out.size() - start < size) {
+            if (out.size() != start) {
+                out.push_back(' ');
+            }
+            out.append(words[word(random)]);
+        }
+    }
+
+    void wide(std::string& out, Random& random, std::size_t row)
+    {
+        static constexpr auto num_keys = 64ul;
+
+        auto number = std::uniform_real_distribution<double>{ -1e6, 1e6 };
+        auto coin   = std::bernoulli_distribution{ 0.5 };
+
+        out.append(std::format("{{\"id\":{}", row));
+        for (auto key = 0ul; key < num_keys; ++key) {
+            out.append(std::format(",\"f{:02}\":", key));
+            switch (key % 4) {
+            case 0: out.append(std::format("{}", static_cast<long>(number(random)))); break;
+            case 1: out.append(std::format("{:.6g}", number(random))); break;
+            case 2: out.append(coin(random) ? "true" : "false"); break;
+            default:
+                out.push_back('"');
+                append_identifier(out, random, 8);
+                out.push_back('"');
+            }
+        }
+        out.push_back('}');
+    }
+
+    void nested(std::string& out, Random& random, std::size_t row, int depth = 0)
+    {
+        static constexpr auto max_depth = 8;
+
+        auto number = std::uniform_real_distribution<double>{ 0.0, 1.0 };
+
+        out.append(std::format("{{\"id\":{},\"weight\":{:.4f},\"tags\":[", row, number(random)));
+        for (auto i = 0; i < 3; ++i) {
+            out.append(i != 0 ? ",\"" : "\"");
+            append_identifier(out, random, 5);
+            out.push_back('"');
+        }
+        out.append(std::format("],\"point\":[{:.3f},{:.3f}]", number(random), number(random)));
+
+        if (depth + 1 < max_depth) {
+            out.append(",\"child\":");
+            nested(out, random, row, depth + 1);
+        }
+        out.push_back('}');
+    }
+
+    void numeric(std::string& out, Random& random, std::size_t row)
+    {
+        static constexpr auto num_values = 256ul;
+
+        auto number = std::normal_distribution<double>{ 0.0, 100.0 };
+
+        out.append(std::format("{{\"id\":{},\"values\":[", row));
+        for (auto i = 0ul; i < num_values; ++i) {
+            if (i != 0) {
+                out.push_back(',');
+            }
+            out.append(std::format("{:.5g}", number(random)));
+        }
+        out.append("]}");
+    }
+
+    void logs(std::string& out, Random& random, std::size_t row)
+    {
+        auto level  = std::uniform_int_distribution<std::size_t>{ 0, levels.size() - 1 };
+        auto status = std::uniform_int_distribution<int>{ 0, 9 };
+        auto length = std::uniform_int_distribution<std::size_t>{ 40, 300 };
+
+        // one line every 10 ms from 2024-01-01T00:00:00Z
+        auto ms      = row * 10;
+        auto seconds = ms / 1000;
+
+        out.append(std::format(
+            "{{\"ts\":\"2024-01-{:02}T{:02}:{:02}:{:02}.{:03}Z\",\"level\":\"{}\",\"host\":\"node-",
+            1 + seconds / 86400 % 28,
+            seconds / 3600 % 24,
+            seconds / 60 % 60,
+            seconds % 60,
+            ms % 1000,
+            levels[level(random)]
+        ));
+        append_identifier(out, random, 4);
+        out.append(std::format("\",\"status\":{},\"msg\":\"", status(random) == 0 ? 500 : 200));
+        append_sentence(out, random, length(random));
+        out.append("\"}");
+    }
+
+    void skewed(std::string& out, Random& random, std::size_t row)
+    {
+        // pareto distributed lengths: most documents are small, a few are a thousand times larger. the
+        // length is capped so a document always fits in the default batch size of the document streams.
+        static constexpr auto min_length = 32.0;
+        static constexpr auto max_length = 256.0 * 1024;
+
+        auto uniform = std::uniform_real_distribution<double>{ 0.0, 1.0 };
+        auto length  = std::min(min_length / std::pow(1.0 - uniform(random), 1.0 / 1.2), max_length);
+
+        out.append(std::format("{{\"id\":{},\"size\":{},\"payload\":\"", row, static_cast<long>(length)));
+        append_sentence(out, random, static_cast<std::size_t>(length));
+        out.append("\"}");
+    }
+}
+
+namespace octave_ndjson::bench
+{
+    std::span<const Shape> all_shapes() noexcept
+    {
+        return detail::shapes;
+    }
+
+    std::string_view to_string(Shape shape) noexcept
+    {
+        switch (shape) {
+        case Shape::Wide: return "wide";
+        case Shape::Nested: return "nested";
+        case Shape::Numeric: return "numeric";
+        case Shape::Logs: return "logs";
+        case Shape::Skewed: return "skewed";
+        }
+        return "";
+    }
+
+    std::optional<Shape> shape_from_string(std::string_view str) noexcept
+    {
+        auto found = std::ranges::find(detail::shapes, str, to_string);
+        return found != detail::shapes.end() ? std::optional{ *found } : std::nullopt;
+    }
+
+    std::string generate(Shape shape, std::size_t bytes, std::uint64_t seed)
+    {
+        auto random = detail::Random{ seed };
+        auto out    = std::string{};
+
+        out.reserve(bytes + 512 * 1024);
+
+        for (auto row = 0ul; out.size() < bytes; ++row) {
+            switch (shape) {
+            case Shape::Wide: detail::wide(out, random, row); break;
+            case Shape::Nested: detail::nested(out, random, row); break;
+            case Shape::Numeric: detail::numeric(out, random, row); break;
+            case Shape::Logs: detail::logs(out, random, row); break;
+            case Shape::Skewed: detail::skewed(out, random, row); break;
+            }
+            out.push_back('\n');
+        }
+
+        return out;
+    }
+}
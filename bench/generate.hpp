@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace octave_ndjson::bench
+{
+    /**
+     * @brief The shapes of the synthetic inputs, each stresses a different part of the decoding.
+     */
+    enum class Shape
+    {
+        // flat records with many keys of mixed types (struct array assembly, columnar layout)
+        Wide,
+
+        // objects nested several levels deep with small arrays (recursion, schema comparison)
+        Nested,
+
+        // records with a long array of numbers (number parsing, array decoding)
+        Numeric,
+
+        // log lines, mostly strings (string decoding)
+        Logs,
+
+        // records whose lengths follow a heavy-tailed distribution (load balancing of the chunks)
+        Skewed,
+    };
+
+    /**
+     * @brief Get every shape, in the order they are benchmarked.
+     */
+    std::span<const Shape> all_shapes() noexcept;
+
+    std::string_view to_string(Shape shape) noexcept;
+
+    std::optional<Shape> shape_from_string(std::string_view str) noexcept;
+
+    /**
+     * @brief Generate an NDJSON input.
+     *
+     * @param shape The shape of the documents.
+     * @param bytes The size of the input, the documents are generated until it's reached.
+     * @param seed Seed of the random generator.
+     *
+     * @return The documents, one per line, each line ends with a newline.
+     *
+     * The output only depends on the arguments, so the same input can be generated again to compare two
+     * builds. Every document of a shape has the same keys in the same order, so the input can be loaded in
+     * any mode and any layout.
+     */
+    std::string generate(Shape shape, std::size_t bytes, std::uint64_t seed);
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+
+namespace octave_ndjson
+{
+    /**
+     * @class Arena
+     *
+     * @brief Per-thread monotonic arena for the temporaries of decoding a document.
+     *
+     * The containers that only live while a document is decoded (e.g. the elements of an On-Demand array
+     * collected before the type of the array is known) are allocated from the arena of their thread by
+     * bumping a pointer, so the workers don't contend on the malloc arenas. The arena is reset between
+     * documents, anything allocated from it must be gone by then.
+     *
+     * The buffer is kept between documents and between calls (the threads of the pool are persistent). A
+     * document that overflows the buffer makes it grow on the next reset (up to `max_size`), so the arena
+     * stops going to the upstream allocator after the first few documents.
+     */
+    class Arena
+    {
+    public:
+        static constexpr auto initial_size = 64ul * 1024;
+        static constexpr auto max_size     = 64ul * 1024 * 1024;
+
+        /**
+         * @brief Get the arena of the current thread.
+         */
+        static Arena& current() noexcept
+        {
+            thread_local auto arena = Arena{};
+            return arena;
+        }
+
+        std::pmr::memory_resource* resource() noexcept
+        {
+            if (not m_resource.has_value()) {
+                grow(initial_size);
+            }
+            return &*m_resource;
+        }
+
+        /**
+         * @brief Get the number of allocations that didn't fit in the buffer since the thread started.
+         */
+        std::size_t allocations() const noexcept { return m_upstream.m_count; }
+
+        /**
+         * @brief Release everything allocated since the last reset.
+         */
+        void reset()
+        {
+            if (not m_resource.has_value()) {
+                return;
+            } else if (m_upstream.m_allocated == 0) {
+                m_resource->release();
+                return;
+            }
+
+            // the upstream chunks grow geometrically, their sum covers what the document needed
+            grow(std::min(std::bit_ceil(m_size + m_upstream.m_allocated), max_size));
+        }
+
+    private:
+        /**
+         * @brief Upstream of the arena, counts the allocations that didn't fit in the buffer.
+         */
+        class Upstream : public std::pmr::memory_resource
+        {
+        public:
+            std::size_t m_allocated = 0;    // bytes since the last grow
+            std::size_t m_count     = 0;    // number of allocations, never reset
+
+        private:
+            void* do_allocate(std::size_t bytes, std::size_t alignment) override
+            {
+                m_allocated += bytes;
+                ++m_count;
+                return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+            }
+
+            void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) override
+            {
+                std::pmr::new_delete_resource()->deallocate(ptr, bytes, alignment);
+            }
+
+            bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+            {
+                return this == &other;
+            }
+        };
+
+        Arena() = default;
+
+        void grow(std::size_t size)
+        {
+            m_resource.reset();    // releases the upstream chunks
+            m_upstream.m_allocated = 0;
+
+            if (size != m_size) {
+                m_buffer = std::make_unique_for_overwrite<std::byte[]>(size);
+                m_size   = size;
+            }
+            m_resource.emplace(m_buffer.get(), m_size, &m_upstream);
+        }
+
+        Upstream                                           m_upstream;
+        std::unique_ptr<std::byte[]>                       m_buffer;
+        std::size_t                                        m_size = 0;
+        std::optional<std::pmr::monotonic_buffer_resource> m_resource;
+    };
+}
@@ -1,15 +1,23 @@
 #include "args.hpp"
 
+#include "filter.hpp"
 #include "ndjson_load.hpp"
 
+#include <octave/Cell.h>
 #include <octave/error.h>
 #include <octave/ov.h>
 #include <octave/ovl.h>
+#include <simdjson.h>
 
 #include <algorithm>
+#include <cmath>
 #include <format>
+#include <limits>
 #include <optional>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <vector>
 
 namespace octave_ndjson::args::detail
 {
@@ -19,10 +27,75 @@ namespace octave_ndjson::args::detail
         if      (str == "strict")   return ParseMode::Strict;
         else if (str == "dynarray") return ParseMode::DynamicArray;
         else if (str == "relaxed")  return ParseMode::Relaxed;
+        else if (str == "union")    return ParseMode::Union;
         else                        return std::nullopt;
         // clang-format on
     }
 
+    std::optional<Layout> layout_from_string(std::string_view str)
+    {
+        // clang-format off
+        if      (str == "rows")     return Layout::Rows;
+        else if (str == "columnar") return Layout::Columnar;
+        else                        return std::nullopt;
+        // clang-format on
+    }
+
+    std::optional<Backend> backend_from_string(std::string_view str)
+    {
+        // clang-format off
+        if      (str == "dom")      return Backend::Dom;
+        else if (str == "ondemand") return Backend::OnDemand;
+        else                        return std::nullopt;
+        // clang-format on
+    }
+
+    std::optional<Numeric> numeric_from_string(std::string_view str)
+    {
+        // clang-format off
+        if      (str == "double")   return Numeric::Double;
+        else if (str == "preserve") return Numeric::Preserve;
+        else if (str == "single")   return Numeric::Single;
+        else if (str == "auto")     return Numeric::Auto;
+        else                        return std::nullopt;
+        // clang-format on
+    }
+
+    std::optional<Filter::Op> filter_op_from_string(std::string_view str)
+    {
+        using Op = Filter::Op;
+
+        // clang-format off
+        if      (str == "==")                return Op::Equal;
+        else if (str == "~=" or str == "!=") return Op::NotEqual;
+        else if (str == "<")                 return Op::Less;
+        else if (str == "<=")                return Op::LessEqual;
+        else if (str == ">")                 return Op::Greater;
+        else if (str == ">=")                return Op::GreaterEqual;
+        else if (str == "prefix")            return Op::Prefix;
+        else                                 return std::nullopt;
+        // clang-format on
+    }
+
+    /**
+     * @brief Convert an Octave value into the value of a predicate.
+     *
+     * @return The value, `[]` is null, or `std::nullopt` if the value is not a string nor a real scalar.
+     */
+    std::optional<Filter::Value> filter_value_from_octave(const octave_value& value)
+    {
+        if (value.is_string()) {
+            return value.string_value();
+        } else if (value.is_bool_scalar()) {
+            return value.bool_value();
+        } else if (value.isnumeric() and value.is_real_scalar()) {
+            return value.double_value();
+        } else if (value.isnumeric() and value.isempty()) {
+            return nullptr;
+        }
+        return std::nullopt;
+    }
+
     std::optional<Threading> threading_from_string(std::string_view str)
     {
         // clang-format off
@@ -31,6 +104,28 @@ namespace octave_ndjson::args::detail
         else                      return std::nullopt;
         // clang-format on
     }
+
+    /**
+     * @brief Convert the value of a count parameter (e.g. 'threads').
+     *
+     * @return The count, or `std::nullopt` if it's not an integer from 1 to `max` (NaN and Inf are not).
+     */
+    std::optional<std::size_t> count_from_double(double value, std::size_t max) noexcept
+    {
+        auto integer = std::isfinite(value) and value == std::floor(value);
+        if (not integer or value < 1 or value > static_cast<double>(max)) {
+            return std::nullopt;
+        }
+        return static_cast<std::size_t>(value);
+    }
+
+    /**
+     * @brief Largest number of threads accepted, more than that only adds contention.
+     */
+    std::size_t max_threads() noexcept
+    {
+        return std::max(std::thread::hardware_concurrency(), 1u) * 4ul;
+    }
 }
 
 namespace octave_ndjson::args
@@ -59,8 +154,24 @@ namespace octave_ndjson::args
 
         auto parsed = ParsedArgs{
             .m_path_or_string = "",
-            .m_mode           = ParseMode::Strict,
+            .m_options        = {
+                .m_mode       = ParseMode::Strict,
+                .m_layout     = Layout::Rows,
+                .m_backend    = Backend::Dom,
+                .m_numeric    = Numeric::Double,
+                .m_threads    = 0,
+                .m_batch_size = simdjson::dom::DEFAULT_BATCH_SIZE,
+                .m_progress   = false,
+                .m_stats      = nullptr,
+                .m_fields     = std::nullopt,
+                .m_where      = std::nullopt,
+            },
             .m_threading      = Threading::Multi,
+            .m_file           = {
+                .m_index = false,
+                .m_cache = false,
+                .m_range = std::nullopt,
+            },
         };
 
         switch (kind) {
@@ -87,7 +198,178 @@ namespace octave_ndjson::args
                 if (not mode) {
                     prefixed_error(std::format("Invalid value '{}' for 'mode'", value).c_str());
                 }
-                parsed.m_mode = *mode;
+                parsed.m_options.m_mode = *mode;
+            } else if (param == "layout") {
+                auto value  = args_str(i++, true, "Expected a string value for 'layout'");
+                auto layout = detail::layout_from_string(value);
+
+                if (not layout) {
+                    prefixed_error(std::format("Invalid value '{}' for 'layout'", value).c_str());
+                }
+                parsed.m_options.m_layout = *layout;
+            } else if (param == "backend") {
+                auto value   = args_str(i++, true, "Expected a string value for 'backend'");
+                auto backend = detail::backend_from_string(value);
+
+                if (not backend) {
+                    prefixed_error(std::format("Invalid value '{}' for 'backend'", value).c_str());
+                }
+                parsed.m_options.m_backend = *backend;
+            } else if (param == "numeric") {
+                auto value   = args_str(i++, true, "Expected a string value for 'numeric'");
+                auto numeric = detail::numeric_from_string(value);
+
+                if (not numeric) {
+                    prefixed_error(std::format("Invalid value '{}' for 'numeric'", value).c_str());
+                }
+                parsed.m_options.m_numeric = *numeric;
+            } else if (param == "threads") {
+                auto value = args(i++);
+                if (not value.isnumeric() or not value.is_real_scalar()) {
+                    prefixed_error("Expected a positive integer value for 'threads'");
+                }
+
+                auto threads = detail::count_from_double(value.double_value(), detail::max_threads());
+                if (not threads) {
+                    auto message = std::format(
+                        "Invalid value '{}' for 'threads', must be an integer from 1 to {}",
+                        value.double_value(),
+                        detail::max_threads()
+                    );
+                    prefixed_error(message.c_str());
+                }
+                parsed.m_options.m_threads = *threads;
+            } else if (param == "batch_size") {
+                auto value = args(i++);
+                if (not value.isnumeric() or not value.is_real_scalar()) {
+                    prefixed_error("Expected a positive integer value for 'batch_size'");
+                }
+
+                // simdjson can't parse more than 4 GiB at once
+                auto max_size   = simdjson::SIMDJSON_MAXSIZE_BYTES;
+                auto batch_size = detail::count_from_double(value.double_value(), max_size);
+                if (not batch_size) {
+                    auto message = std::format(
+                        "Invalid value '{}' for 'batch_size', must be an integer from 1 to {}",
+                        value.double_value(),
+                        max_size
+                    );
+                    prefixed_error(message.c_str());
+                }
+                parsed.m_options.m_batch_size = *batch_size;
+            } else if (param == "progress") {
+                auto value = args(i++);
+                if (not value.is_bool_scalar() and not (value.isnumeric() and value.is_real_scalar())) {
+                    prefixed_error("Expected a logical value for 'progress'");
+                }
+                parsed.m_options.m_progress = value.is_true();
+            } else if (param == "fields") {
+                auto value = args(i++);
+                auto paths = std::vector<std::string>{};
+
+                if (value.is_string()) {
+                    paths.push_back(value.string_value());
+                } else if (value.iscellstr()) {
+                    auto cellstr = value.cellstr_value();
+                    for (auto j = 0l; j < cellstr.numel(); ++j) {
+                        paths.push_back(cellstr(j));
+                    }
+                } else {
+                    prefixed_error("Expected a string or a cell array of strings for 'fields'");
+                }
+
+                try {
+                    parsed.m_options.m_fields.emplace(std::move(paths));
+                } catch (const std::invalid_argument& e) {
+                    prefixed_error(std::format("Invalid value for 'fields': {}", e.what()).c_str());
+                }
+            } else if (param == "where") {
+                auto value = args(i++);
+                if (not value.iscell()) {
+                    prefixed_error("Expected a {field, op, value} cell or a cell array of them for 'where'");
+                }
+
+                // a single predicate or a list of them, told apart by the first element
+                auto cell = value.cell_value();
+                auto list = cell.numel() > 0 and cell(0).iscell() ? cell : Cell{ value };
+
+                auto predicates = std::vector<Filter::Predicate>{};
+                for (auto j = 0l; j < list.numel(); ++j) {
+                    auto predicate = list(j).iscell() ? list(j).cell_value() : Cell{};
+                    auto valid     = predicate.numel() == 3 and predicate(0).is_string()
+                             and predicate(1).is_string();
+
+                    if (not valid) {
+                        prefixed_error("Expected a {field, op, value} cell for each predicate of 'where'");
+                    }
+
+                    auto op_str = predicate(1).string_value();
+                    auto op     = detail::filter_op_from_string(op_str);
+                    auto val    = detail::filter_value_from_octave(predicate(2));
+
+                    if (not op) {
+                        prefixed_error(std::format("Invalid operator '{}' for 'where'", op_str).c_str());
+                    } else if (not val) {
+                        prefixed_error("Expected a string, a real scalar, or [] as the value of 'where'");
+                    }
+                    predicates.emplace_back(predicate(0).string_value(), *op, std::move(*val));
+                }
+
+                try {
+                    parsed.m_options.m_where.emplace(std::move(predicates));
+                } catch (const std::invalid_argument& e) {
+                    prefixed_error(std::format("Invalid value for 'where': {}", e.what()).c_str());
+                }
+            } else if (param == "index") {
+                if (kind != Kind::File) {
+                    prefixed_error("Parameter 'index' is only supported for files");
+                }
+
+                auto value = args(i++);
+                if (not value.is_bool_scalar() and not (value.isnumeric() and value.is_real_scalar())) {
+                    prefixed_error("Expected a logical value for 'index'");
+                }
+                parsed.m_file.m_index = value.is_true();
+            } else if (param == "cache") {
+                if (kind != Kind::File) {
+                    prefixed_error("Parameter 'cache' is only supported for files");
+                }
+
+                auto value = args(i++);
+                if (not value.is_bool_scalar() and not (value.isnumeric() and value.is_real_scalar())) {
+                    prefixed_error("Expected a logical value for 'cache'");
+                }
+                parsed.m_file.m_cache = value.is_true();
+            } else if (param == "range") {
+                if (kind != Kind::File) {
+                    prefixed_error("Parameter 'range' is only supported for files");
+                }
+
+                auto value = args(i++);
+                if (not value.isnumeric() or value.numel() != 2) {
+                    prefixed_error("Expected a [first last] vector for 'range'");
+                }
+
+                auto range = value.array_value();
+                auto first = range(0);
+                auto last  = range(1);
+
+                // first is at most 2^53, above that a double doesn't hold every integer anymore. last is
+                // inclusive and may be Inf, std::floor(Inf) is Inf
+                auto max_first = std::size_t{ 1 } << 53;
+                auto start     = detail::count_from_double(first, max_first);
+                auto valid     = start.has_value() and last >= first and last == std::floor(last);
+
+                if (not valid) {
+                    prefixed_error(std::format("Invalid value [{} {}] for 'range'", first, last).c_str());
+                }
+
+                // a last that doesn't fit in size_t is the same as Inf (the max rounds up to 2^64 as double)
+                auto max_last = std::numeric_limits<std::size_t>::max();
+                auto end      = last >= static_cast<double>(max_last) ? max_last
+                                                                      : static_cast<std::size_t>(last);
+
+                parsed.m_file.m_range.emplace(*start - 1, end);
             } else if (param == "threading") {
                 auto value = args_str(i++, true, "Expected a string value for 'threading'");
                 auto mode  = detail::threading_from_string(value);
@@ -101,6 +383,84 @@ namespace octave_ndjson::args
             }
         }
 
+        const auto& options = parsed.m_options;
+        if (options.m_backend == Backend::OnDemand and options.m_layout == Layout::Columnar) {
+            prefixed_error("Columnar layout is not supported by the 'ondemand' backend");
+        }
+        if (options.m_numeric != Numeric::Double and options.m_layout != Layout::Columnar) {
+            prefixed_error("The 'numeric' parameter requires the columnar layout");
+        }
+        if (options.m_mode == ParseMode::Union and options.m_fields) {
+            prefixed_error("The 'fields' parameter is not supported by the 'union' mode");
+        }
+        if (options.m_mode == ParseMode::Union and options.m_numeric != Numeric::Double) {
+            prefixed_error("The 'numeric' parameter is not supported by the 'union' mode");
+        }
+
+        return parsed;
+    }
+
+    SaveArgs parse_save(const octave_value_list& args, Kind kind, const char* error_prefix)
+    {
+        const auto prefixed_error = [&](const char* message) { error("%s\n%s", error_prefix, message); };
+
+        const auto positional = kind == Kind::File ? 2l : 1l;
+        const auto size       = args.length();
+
+        if (size < positional) {
+            auto message = std::format("Incorrect number of arguments, at least {} is required.", positional);
+            prefixed_error(message.c_str());
+        }
+
+        auto parsed = SaveArgs{
+            .m_path    = "",
+            .m_value   = positional - 1,
+            .m_threads = 0,
+        };
+
+        if (kind == Kind::File) {
+            if (not args(0).is_string()) {
+                prefixed_error("First argument must be a file path");
+            }
+            parsed.m_path = args(0).string_value();
+        }
+
+        auto i = positional;
+        while (i < size) {
+            if (not args(i).is_string()) {
+                prefixed_error("Expected a string parameter");
+            }
+
+            auto param = args(i++).string_value();
+            std::transform(param.begin(), param.end(), param.begin(), [](char c) {
+                return static_cast<char>(std::tolower(c));
+            });
+
+            if (i >= size) {
+                prefixed_error(std::format("Expected a value for parameter '{}'", param).c_str());
+            }
+
+            if (param == "threads") {
+                auto value = args(i++);
+                if (not value.isnumeric() or not value.is_real_scalar()) {
+                    prefixed_error("Expected a positive integer value for 'threads'");
+                }
+
+                auto threads = detail::count_from_double(value.double_value(), detail::max_threads());
+                if (not threads) {
+                    auto message = std::format(
+                        "Invalid value '{}' for 'threads', must be an integer from 1 to {}",
+                        value.double_value(),
+                        detail::max_threads()
+                    );
+                    prefixed_error(message.c_str());
+                }
+                parsed.m_threads = *threads;
+            } else {
+                prefixed_error(std::format("Unknown parameter '{}'", param).c_str());
+            }
+        }
+
         return parsed;
     }
 }
@@ -1,15 +1,14 @@
 #pragma once
 
+#include "ndjson_load.hpp"
+
+#include <cstddef>
+#include <optional>
 #include <string>
+#include <utility>
 
 class octave_value_list;
 
-namespace octave_ndjson
-{
-    // defined in ndjson_load.hpp
-    enum class ParseMode;
-}
-
 namespace octave_ndjson::args
 {
     enum class Threading
@@ -24,11 +23,23 @@ namespace octave_ndjson::args
         File,
     };
 
+    /**
+     * @brief Arguments that only apply when loading a file.
+     */
+    struct FileArgs
+    {
+        bool m_index;    // use the line index sidecar, create it if missing or stale
+        bool m_cache;    // use the result cache, create it if missing or stale
+
+        std::optional<std::pair<std::size_t, std::size_t>> m_range;    // lines [first, last), 0-based
+    };
+
     struct ParsedArgs
     {
         std::string m_path_or_string;
-        ParseMode   m_mode;
+        Options     m_options;
         Threading   m_threading;
+        FileArgs    m_file;
     };
 
     /**
@@ -43,4 +54,25 @@ namespace octave_ndjson::args
      * @throw <internal_octave_error> if parsing failed.
      */
     ParsedArgs parse(const octave_value_list& args, Kind kind, const char* error_prefix);
+
+    struct SaveArgs
+    {
+        std::string m_path;       // empty for `Kind::String`
+        long        m_value;      // index of the value to be saved in the argument list
+        std::size_t m_threads;    // number of threads, 0 means default
+    };
+
+    /**
+     * @brief Parse octave argument list of the save functions.
+     *
+     * @param args The argument list.
+     * @param kind `Kind::File` if the first argument is a filepath followed by the value, `Kind::String` if
+     *             the first argument is the value.
+     * @param error_prefix Prefix to be added to error message when error happen.
+     *
+     * @return SaveArgs on success.
+     *
+     * @throw <internal_octave_error> if parsing failed.
+     */
+    SaveArgs parse_save(const octave_value_list& args, Kind kind, const char* error_prefix);
 }
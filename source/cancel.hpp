@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+namespace octave_ndjson
+{
+    /**
+     * @brief Thrown by the decoders when the load they are part of is cancelled (see `CancelScope`).
+     */
+    struct Cancelled
+    {
+    };
+
+    /**
+     * @class CancelScope
+     *
+     * @brief Make the decoders running on the current thread poll a stop flag while the scope is alive.
+     *
+     * The multi-threaded load sets the flag as soon as a thread hits an error, so the other threads stop in
+     * the middle of the document they are decoding (at the next array) instead of finishing it first.
+     */
+    class CancelScope
+    {
+    public:
+        explicit CancelScope(const std::atomic<bool>& stop) noexcept
+            : m_prev{ std::exchange(current(), &stop) }
+        {
+        }
+
+        ~CancelScope() { current() = m_prev; }
+
+        CancelScope(const CancelScope&)            = delete;
+        CancelScope& operator=(const CancelScope&) = delete;
+
+        /**
+         * @brief Throw `Cancelled` if the stop flag of the current thread is set.
+         */
+        static void poll()
+        {
+            if (auto* stop = current(); stop != nullptr and stop->load(std::memory_order_relaxed)) {
+                throw Cancelled{};
+            }
+        }
+
+    private:
+        static const std::atomic<bool>*& current() noexcept
+        {
+            thread_local auto stop = static_cast<const std::atomic<bool>*>(nullptr);
+            return stop;
+        }
+
+        const std::atomic<bool>* m_prev;
+    };
+}
@@ -0,0 +1,376 @@
+#include "columnar.hpp"
+
+#include "decode_plan.hpp"
+#include "ndjson_load.hpp"
+#include "parse_octave_value.hpp"
+#include "util.hpp"
+
+#include <octave/int16NDArray.h>
+#include <octave/int32NDArray.h>
+#include <octave/int64NDArray.h>
+#include <octave/int8NDArray.h>
+#include <octave/oct-map.h>
+#include <octave/ov.h>
+#include <octave/uint16NDArray.h>
+#include <octave/uint32NDArray.h>
+#include <octave/uint64NDArray.h>
+#include <octave/uint8NDArray.h>
+#include <simdjson.h>
+
+#include <algorithm>
+#include <bit>
+#include <format>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+namespace octave_ndjson::detail
+{
+    /**
+     * @brief The range and kinds of the numbers of a column.
+     */
+    struct NumberStats
+    {
+        bool          m_null     = false;
+        bool          m_double   = false;
+        bool          m_single   = true;    // every number is exactly representable as single
+        std::int64_t  m_min      = 0;
+        std::uint64_t m_max      = 0;
+        bool          m_negative = false;    // `m_min` is only meaningful if set
+    };
+
+    template <typename Int>
+    bool fits(const NumberStats& stats)
+    {
+        using Limits = std::numeric_limits<Int>;
+
+        if (stats.m_negative and (not Limits::is_signed or stats.m_min < Limits::min())) {
+            return false;
+        }
+        return stats.m_max <= static_cast<std::uint64_t>(Limits::max());
+    }
+
+    template <typename Array, typename Numbers>
+    octave_value convert_numbers(const Numbers& numbers)
+    {
+        using Elem = typename Array::element_type;
+
+        using Kind = typename Numbers::Kind;
+
+        auto array = Array{ dim_vector{ static_cast<long>(numbers.size()), 1 } };
+        auto data  = array.fortran_vec();
+
+        for (auto i = 0ul; i < numbers.size(); ++i) {
+            auto value = numbers.m_values[i];
+            switch (numbers.m_kinds[i]) {
+            case Kind::Null: data[i] = static_cast<Elem>(octave_NaN); break;
+            case Kind::Int64: data[i] = static_cast<Elem>(std::bit_cast<std::int64_t>(value)); break;
+            case Kind::UInt64: data[i] = static_cast<Elem>(value); break;
+            case Kind::Double: data[i] = static_cast<Elem>(std::bit_cast<double>(value)); break;
+            }
+        }
+
+        return array;
+    }
+
+    template <typename Numbers>
+    octave_value convert_narrowest_unsigned(const Numbers& numbers, const NumberStats& stats)
+    {
+        // clang-format off
+        if      (fits<std::uint8_t>(stats))  return convert_numbers<uint8NDArray>(numbers);
+        else if (fits<std::uint16_t>(stats)) return convert_numbers<uint16NDArray>(numbers);
+        else if (fits<std::uint32_t>(stats)) return convert_numbers<uint32NDArray>(numbers);
+        else                                 return convert_numbers<uint64NDArray>(numbers);
+        // clang-format on
+    }
+
+    template <typename Numbers>
+    octave_value convert_narrowest_signed(const Numbers& numbers, const NumberStats& stats)
+    {
+        // clang-format off
+        if      (fits<std::int8_t>(stats))  return convert_numbers<int8NDArray>(numbers);
+        else if (fits<std::int16_t>(stats)) return convert_numbers<int16NDArray>(numbers);
+        else if (fits<std::int32_t>(stats)) return convert_numbers<int32NDArray>(numbers);
+        else                                return convert_numbers<int64NDArray>(numbers);
+        // clang-format on
+    }
+}
+
+namespace octave_ndjson
+{
+    Columnar::Columnar(simdjson::dom::element reference, std::size_t rows, Numeric numeric)
+        : m_rows{ rows }
+        , m_numeric{ numeric }
+    {
+        if (not reference.is_object()) {
+            throw std::runtime_error{ "Columnar layout requires the documents to be objects" };
+        }
+        create_columns(simdjson::dom::object{ reference });
+    }
+
+    Columnar::Columnar(std::span<const Projection::Field> reference, std::size_t rows, Numeric numeric)
+        : m_rows{ rows }
+        , m_numeric{ numeric }
+    {
+        create_columns(reference);
+    }
+
+    void Columnar::insert(std::size_t row, simdjson::dom::element elem, const DecodePlan* plan)
+    {
+        auto object = elem.get_object();
+        if (object.error()) {
+            if (plan != nullptr) {
+                throw DecodePlan::Mismatch{};
+            }
+            throw std::runtime_error{ "Columnar layout requires the documents to be objects" };
+        }
+        insert_fields(row, object.value_unsafe(), plan);
+    }
+
+    void Columnar::insert(std::size_t row, std::span<const Projection::Field> fields, const DecodePlan* plan)
+    {
+        insert_fields(row, fields, plan);
+    }
+
+    template <typename Fields>
+    void Columnar::create_columns(Fields&& fields)
+    {
+        using T = simdjson::dom::element_type;
+
+        auto dims = dim_vector{ static_cast<long>(m_rows), 1 };
+
+        auto number_column = [&]() -> decltype(Column::m_data) {
+            switch (m_numeric) {
+            case Numeric::Double: return NDArray{ dims, octave_NaN };
+            case Numeric::Single: return FloatNDArray{ dims, octave_Float_NaN };
+            case Numeric::Preserve:
+            case Numeric::Auto: return Numbers(m_rows);
+            }
+            std::unreachable();
+        };
+
+        for (auto [key, value] : fields) {
+            auto& column = m_columns.emplace_back(std::string{ key.data(), key.size() }, Cell{});
+            switch (value.type()) {
+            case T::INT64:
+            case T::UINT64:
+            case T::DOUBLE: column.m_data = number_column(); break;
+            case T::BOOL: column.m_data = boolNDArray{ dims, false }; break;
+            default: column.m_data = Cell{ dims }; break;
+            }
+        }
+    }
+
+    template <typename Fields>
+    void Columnar::insert_fields(std::size_t row, Fields&& fields, const DecodePlan* plan)
+    {
+        using T = simdjson::dom::element_type;
+
+        auto index  = static_cast<long>(row);
+        auto column = m_columns.begin();
+
+        for (auto [key, value] : fields) {
+            if (column == m_columns.end() or column->m_name != key) {
+                if (plan != nullptr) {
+                    throw DecodePlan::Mismatch{};
+                }
+                throw std::runtime_error{ std::format(
+                    "Mismatched keys, columnar layout requires all documents to have the same keys in the "
+                    "same order (unexpected key: '{}')",
+                    std::string_view{ key }
+                ) };
+            }
+
+            auto mismatch = [&](std::string_view expected) {
+                if (plan != nullptr) {
+                    throw DecodePlan::Mismatch{};
+                }
+                throw std::runtime_error{ std::format(
+                    "Mismatched type, column '{}' expects a {}", column->m_name, expected
+                ) };
+            };
+
+            auto visit = util::Overload{
+                [&](NDArray& array) {
+                    if (value.is_null() and plan == nullptr) {
+                        array.xelem(index) = octave_NaN;
+                    } else if (auto number = value.get_double(); not number.error()) {
+                        array.xelem(index) = number.value_unsafe();
+                    } else {
+                        mismatch("number");
+                    }
+                },
+                [&](FloatNDArray& array) {
+                    if (value.is_null() and plan == nullptr) {
+                        array.xelem(index) = octave_Float_NaN;
+                    } else if (auto number = value.get_double(); not number.error()) {
+                        array.xelem(index) = static_cast<float>(number.value_unsafe());
+                    } else {
+                        mismatch("number");
+                    }
+                },
+                [&](Numbers& numbers) {
+                    using K = Numbers::Kind;
+
+                    auto set = [&](K kind, auto number) {
+                        numbers.m_values[row] = std::bit_cast<std::uint64_t>(number);
+                        numbers.m_kinds[row]  = kind;
+                    };
+
+                    switch (value.type()) {
+                    case T::INT64: set(K::Int64, value.get_int64().value_unsafe()); break;
+                    case T::UINT64: set(K::UInt64, value.get_uint64().value_unsafe()); break;
+                    case T::DOUBLE: set(K::Double, value.get_double().value_unsafe()); break;
+                    case T::NULL_VALUE:
+                        if (plan == nullptr) {
+                            set(K::Null, std::uint64_t{ 0 });
+                            break;
+                        }
+                        [[fallthrough]];
+                    default: mismatch("number");
+                    }
+                },
+                [&](boolNDArray& array) {
+                    if (auto boolean = value.get_bool(); not boolean.error()) {
+                        array.xelem(index) = boolean.value_unsafe();
+                    } else {
+                        mismatch("boolean");
+                    }
+                },
+                [&](Cell& cell) {
+                    auto field        = static_cast<std::size_t>(column - m_columns.begin());
+                    cell.xelem(index) = plan ? plan->decode_field(field, value) : parse_octave_value(value);
+                },
+            };
+            std::visit(visit, column->m_data);
+
+            ++column;
+        }
+
+        if (column != m_columns.end()) {
+            if (plan != nullptr) {
+                throw DecodePlan::Mismatch{};
+            }
+            throw std::runtime_error{ std::format(
+                "Mismatched keys, columnar layout requires all documents to have the same keys in the same "
+                "order (missing key: '{}')",
+                column->m_name
+            ) };
+        }
+    }
+
+    void Columnar::resize(std::size_t rows)
+    {
+        auto dims  = dim_vector{ static_cast<long>(rows), 1 };
+        auto visit = util::Overload{
+            [&](NDArray& array) { array.resize(dims, octave_NaN); },
+            [&](FloatNDArray& array) { array.resize(dims, octave_Float_NaN); },
+            [&](Numbers& numbers) { numbers.resize(rows); },
+            [&](boolNDArray& array) { array.resize(dims, false); },
+            [&](Cell& cell) { cell.resize(dims); },
+        };
+
+        for (auto& column : m_columns) {
+            std::visit(visit, column.m_data);
+        }
+        m_rows = rows;
+    }
+
+    void Columnar::keep(std::span<const std::size_t> rows)
+    {
+        // the rows are increasing, so each row is moved to the same or an earlier position
+        auto gather = [&](auto* data) {
+            for (auto i = 0ul; i < rows.size(); ++i) {
+                if (rows[i] != i) {
+                    data[i] = std::move(data[rows[i]]);
+                }
+            }
+        };
+        auto visit = util::Overload{
+            [&](Numbers& numbers) {
+                gather(numbers.m_values.data());
+                gather(numbers.m_kinds.data());
+            },
+            [&](auto& array) { gather(array.fortran_vec()); },
+        };
+
+        for (auto& column : m_columns) {
+            std::visit(visit, column.m_data);
+        }
+        resize(rows.size());
+    }
+
+    octave_scalar_map Columnar::release(std::size_t rows) &&
+    {
+        if (rows != m_rows) {
+            resize(rows);
+        }
+
+        auto map   = octave_scalar_map{};
+        auto visit = util::Overload{
+            [&](Numbers& numbers) { return release_numbers(numbers, m_numeric); },
+            [&](auto& data) { return octave_value{ std::move(data) }; },
+        };
+
+        for (auto& column : m_columns) {
+            map.assign(column.m_name, std::visit(visit, column.m_data));
+        }
+        return map;
+    }
+
+    octave_value Columnar::release_numbers(const Numbers& numbers, Numeric numeric)
+    {
+        using K = Numbers::Kind;
+
+        auto stats = detail::NumberStats{};
+
+        for (auto i = 0ul; i < numbers.size(); ++i) {
+            auto bits = numbers.m_values[i];
+            switch (numbers.m_kinds[i]) {
+            case K::Null: stats.m_null = true; break;
+            case K::Int64: {
+                auto value = std::bit_cast<std::int64_t>(bits);
+                if (value < 0) {
+                    stats.m_min      = stats.m_negative ? std::min(stats.m_min, value) : value;
+                    stats.m_negative = true;
+                } else {
+                    stats.m_max = std::max(stats.m_max, bits);
+                }
+                // the cast back is only defined below 2^63
+                auto single    = static_cast<float>(value);
+                auto exact     = single < 0x1p63f and static_cast<std::int64_t>(single) == value;
+                stats.m_single = stats.m_single and exact;
+                break;
+            }
+            case K::UInt64:
+                stats.m_max    = std::max(stats.m_max, bits);
+                stats.m_single = false;    // larger than 2^63
+                break;
+            case K::Double: {
+                auto value     = std::bit_cast<double>(bits);
+                stats.m_double = true;
+                stats.m_single = stats.m_single and static_cast<double>(static_cast<float>(value)) == value;
+                break;
+            }
+            }
+        }
+
+        // integers are only possible if there are no nulls and no non-integers
+        if (not stats.m_null and not stats.m_double) {
+            if (numeric == Numeric::Preserve and detail::fits<std::int64_t>(stats)) {
+                return detail::convert_numbers<int64NDArray>(numbers);
+            } else if (numeric == Numeric::Preserve and not stats.m_negative) {
+                return detail::convert_numbers<uint64NDArray>(numbers);
+            } else if (numeric == Numeric::Auto and not stats.m_negative) {
+                return detail::convert_narrowest_unsigned(numbers, stats);
+            } else if (numeric == Numeric::Auto and detail::fits<std::int64_t>(stats)) {
+                return detail::convert_narrowest_signed(numbers, stats);
+            }
+        }
+
+        if (numeric == Numeric::Auto and stats.m_single) {
+            return detail::convert_numbers<FloatNDArray>(numbers);
+        }
+        return detail::convert_numbers<NDArray>(numbers);
+    }
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include "projection.hpp"
+
+#include <octave/Cell.h>
+#include <octave/boolNDArray.h>
+#include <octave/dNDArray.h>
+#include <octave/fNDArray.h>
+#include <simdjson/dom/element.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <variant>
+#include <vector>
+
+class octave_scalar_map;
+class octave_value;
+
+namespace octave_ndjson
+{
+    class DecodePlan;
+    enum class Numeric;
+
+    /**
+     * @class Columnar
+     *
+     * @brief Column storage for documents with object root, one column per top-level key.
+     *
+     * The columns are deduced from the reference (first) document: a number becomes an `NDArray` column, a
+     * boolean becomes a `boolNDArray` column, and anything else becomes a `Cell` column. Every document is
+     * then decoded directly into the columns at its row, without creating any intermediate
+     * `octave_scalar_map`.
+     *
+     * The storage of the number columns depends on the `Numeric` option. For `Numeric::Preserve` and
+     * `Numeric::Auto` the numbers are kept with their original type while decoding and the type of each
+     * column is decided on release, once every number of the column is known.
+     */
+    class Columnar
+    {
+    public:
+        /**
+         * @brief Create the columns from the reference document.
+         *
+         * @param reference The reference document.
+         * @param rows Initial number of rows.
+         * @param numeric Storage of the number columns.
+         *
+         * @throw std::runtime_error if the reference document is not an object.
+         */
+        Columnar(simdjson::dom::element reference, std::size_t rows, Numeric numeric);
+
+        /**
+         * @brief Create the columns from the selected fields of the reference document.
+         *
+         * @param reference The selected fields of the reference document.
+         * @param rows Initial number of rows.
+         * @param numeric Storage of the number columns.
+         */
+        Columnar(std::span<const Projection::Field> reference, std::size_t rows, Numeric numeric);
+
+        /**
+         * @brief Decode a document into the columns at specified row.
+         *
+         * @param row The row index, must be less than `rows()`.
+         * @param elem The simdjson dom element.
+         * @param plan Decode plan compiled from the reference document (strict mode only).
+         *
+         * @throw std::runtime_error if the document keys or the column types mismatch.
+         * @throw DecodePlan::Mismatch instead of the above if `plan` is provided.
+         * @throw simdjson::simdjson_error on parsing error.
+         *
+         * Inserting to different rows from multiple threads at the same time is safe.
+         */
+        void insert(std::size_t row, simdjson::dom::element elem, const DecodePlan* plan = nullptr);
+
+        /**
+         * @brief Decode the selected fields of a document into the columns at specified row.
+         *
+         * @param row The row index, must be less than `rows()`.
+         * @param fields The selected fields of the document.
+         * @param plan Decode plan compiled from the schema of the selected fields (strict mode only).
+         *
+         * Same as the other overload.
+         */
+        void insert(
+            std::size_t                        row,
+            std::span<const Projection::Field> fields,
+            const DecodePlan*                  plan = nullptr
+        );
+
+        /**
+         * @brief Resize the number of rows of all columns (not thread-safe).
+         */
+        void resize(std::size_t rows);
+
+        /**
+         * @brief Keep only the specified rows, moved to the front in the same order (not thread-safe).
+         *
+         * @param rows The rows to be kept, in increasing order.
+         */
+        void keep(std::span<const std::size_t> rows);
+
+        std::size_t rows() const noexcept { return m_rows; }
+
+        /**
+         * @brief Create a scalar struct with each column as its field.
+         *
+         * @param rows Number of rows to be kept.
+         */
+        octave_scalar_map release(std::size_t rows) &&;
+
+    private:
+        /**
+         * @brief Numbers with their original type, narrowed on release.
+         *
+         * Each number is stored as its raw 8 bytes with a 1-byte kind per row. The kind is a whole byte (not
+         * a bit of a null bitmap) so that threads inserting adjacent rows never write to the same byte.
+         */
+        struct Numbers
+        {
+            enum class Kind : std::uint8_t
+            {
+                Null = 0,
+                Int64,
+                UInt64,
+                Double,
+            };
+
+            std::vector<std::uint64_t> m_values;
+            std::vector<Kind>          m_kinds;
+
+            explicit Numbers(std::size_t rows)
+                : m_values(rows)
+                , m_kinds(rows, Kind::Null)
+            {
+            }
+
+            void resize(std::size_t rows)
+            {
+                m_values.resize(rows);
+                m_kinds.resize(rows, Kind::Null);
+            }
+
+            std::size_t size() const noexcept { return m_kinds.size(); }
+        };
+
+        struct Column
+        {
+            std::string                                                     m_name;
+            std::variant<NDArray, FloatNDArray, Numbers, boolNDArray, Cell> m_data;
+        };
+
+        static octave_value release_numbers(const Numbers& numbers, Numeric numeric);
+
+        template <typename Fields>
+        void create_columns(Fields&& fields);
+
+        template <typename Fields>
+        void insert_fields(std::size_t row, Fields&& fields, const DecodePlan* plan);
+
+        std::vector<Column> m_columns;
+        std::size_t         m_rows;
+        Numeric             m_numeric;
+    };
+}
@@ -0,0 +1,397 @@
+#include "decode_plan.hpp"
+
+#include "cancel.hpp"
+#include "parse_octave_value.hpp"
+#include "schema.hpp"
+#include "util.hpp"
+
+#include <octave/Cell.h>
+#include <octave/oct-map.h>
+#include <octave/ov.h>
+#include <simdjson/dom.h>
+
+#include <algorithm>
+#include <iterator>
+#include <span>
+#include <variant>
+
+namespace octave_ndjson
+{
+    DecodePlan::DecodePlan(const Schema& schema)
+    {
+        auto it = schema.begin();
+        compile(it);
+    }
+
+    std::size_t DecodePlan::compile(Schema::Iterator& it)
+    {
+        auto node_index = m_nodes.size();
+        auto edges      = std::vector<Edge>{};
+
+        m_nodes.push_back({ Kind::Null, ArrayKind::Empty, 0, 0, no_fields, no_shape });
+
+        auto visit = util::Overload{
+            [&](Schema::Scalar scalar) {
+                switch (scalar) {
+                case Schema::Scalar::Number: return Kind::Number;
+                case Schema::Scalar::String: return Kind::String;
+                case Schema::Scalar::Bool: return Kind::Bool;
+                case Schema::Scalar::Null: return Kind::Null;
+                default: [[unlikely]] std::abort();
+                }
+            },
+            [&](Schema::Object) {
+                while (*it != Schema::Part{ Schema::Object::End }) {
+                    auto key   = std::string{ std::get<Schema::Key>(*it++).m_key };
+                    auto child = compile(it);
+                    edges.emplace_back(std::move(key), child);
+                }
+                ++it;    // Object::End
+                return Kind::Object;
+            },
+            [&](Schema::Array) {
+                while (*it != Schema::Part{ Schema::Array::End }) {
+                    auto child = compile(it);
+                    edges.emplace_back(std::string{}, child);
+                }
+                ++it;    // Array::End
+                return Kind::Array;
+            },
+            [&](const Schema::Key&) -> Kind {
+                [[unlikely]] std::abort();    // keys are consumed by the object
+            },
+        };
+
+        auto kind       = std::visit(visit, *it++);
+        auto array_kind = ArrayKind::Empty;
+
+        // mirrors the type detection in `detail::decode_array`
+        if (kind == Kind::Array and not edges.empty()) {
+            auto first_kind = m_nodes[edges.front().m_node].m_kind;
+            auto same_type  = true;
+            auto is_numeric = true;
+
+            for (const auto& edge : edges) {
+                auto current  = m_nodes[edge.m_node].m_kind;
+                is_numeric   &= current == Kind::Number or current == Kind::Null;
+                same_type    &= current == first_kind;
+            }
+
+            if (is_numeric) {
+                array_kind = ArrayKind::Numeric;
+            } else if (not same_type or first_kind == Kind::String) {
+                array_kind = ArrayKind::Mixed;
+            } else if (first_kind == Kind::Bool) {
+                array_kind = ArrayKind::Boolean;
+            } else if (first_kind == Kind::Object) {
+                array_kind = ArrayKind::Objects;
+            } else {
+                array_kind = ArrayKind::Arrays;
+            }
+        }
+
+        // the keys are known beforehand, so the objects can share the fields instead of each creating their
+        // own copy of the keys
+        auto fields = no_fields;
+        if (kind == Kind::Object) {
+            auto keys = string_vector{ static_cast<long>(edges.size()) };
+            for (auto i = 0ul; i < edges.size(); ++i) {
+                keys(static_cast<long>(i)) = edges[i].m_key;
+            }
+
+            auto& created = m_fields.emplace_back(keys);
+            if (created.nfields() == static_cast<long>(edges.size())) {
+                fields = m_fields.size() - 1;
+            } else {
+                m_fields.pop_back();    // duplicate keys
+            }
+        }
+
+        auto& node        = m_nodes[node_index];
+        node.m_kind       = kind;
+        node.m_array_kind = array_kind;
+        node.m_first      = m_edges.size();
+        node.m_count      = edges.size();
+        node.m_fields     = fields;
+
+        std::ranges::move(edges, std::back_inserter(m_edges));
+
+        // the lengths of the arrays are fixed by the schema, so the shape is only inferred once here
+        auto dims    = std::vector<std::size_t>{};
+        auto is_bool = std::optional<bool>{};
+        if (array_kind == ArrayKind::Arrays and infer_shape(m_nodes[node_index], 0, dims, is_bool)) {
+            auto shape  = Shape{ dim_vector{}, std::vector<std::size_t>(dims.size()), *is_bool };
+            auto stride = 1ul;
+
+            shape.m_dims.resize(static_cast<int>(dims.size()));
+            for (auto i = 0ul; i < dims.size(); ++i) {
+                shape.m_dims(static_cast<int>(i)) = static_cast<long>(dims[i]);
+                shape.m_strides[i]                = stride;
+                stride                           *= dims[i];
+            }
+
+            m_nodes[node_index].m_shape = m_shapes.size();
+            m_shapes.push_back(std::move(shape));
+        }
+
+        return node_index;
+    }
+
+    // mirrors `detail::infer_shape`, on the plan instead of the tape
+    bool DecodePlan::infer_shape(
+        const Node&               node,
+        std::size_t               depth,
+        std::vector<std::size_t>& dims,
+        std::optional<bool>&      is_bool
+    ) const
+    {
+        auto is_leaf = node.m_array_kind == ArrayKind::Numeric or node.m_array_kind == ArrayKind::Boolean;
+        if (node.m_kind != Kind::Array or not (is_leaf or node.m_array_kind == ArrayKind::Arrays)) {
+            return false;    // also an empty subarray, which is decoded as 0x0 and never stacked
+        }
+
+        // the innermost arrays must all be at the same level, no level can be added after one is found
+        if (depth == dims.size() and not is_bool.has_value()) {
+            dims.push_back(node.m_count);
+        } else if (depth >= dims.size() or dims[depth] != node.m_count) {
+            return false;
+        }
+
+        if (is_leaf) {
+            auto leaf_bool = node.m_array_kind == ArrayKind::Boolean;
+            if (depth + 1 != dims.size() or is_bool.value_or(leaf_bool) != leaf_bool) {
+                return false;
+            }
+            is_bool = leaf_bool;
+            return true;
+        }
+
+        auto edges = std::span{ m_edges.begin() + static_cast<long>(node.m_first), node.m_count };
+        return std::ranges::all_of(edges, [&](const Edge& edge) {
+            return infer_shape(m_nodes[edge.m_node], depth + 1, dims, is_bool);
+        });
+    }
+
+    // validates the array against the plan while writing it, like the other decoders of the plan
+    template <typename Elem>
+    void DecodePlan::write_shaped(
+        const Node&                  node,
+        simdjson::dom::array         array,
+        Elem*                        data,
+        std::span<const std::size_t> strides
+    ) const
+    {
+        using T = simdjson::dom::element_type;
+
+        auto edges = std::span{ m_edges.begin() + static_cast<long>(node.m_first), node.m_count };
+
+        for (auto index = 0ul; auto value : array) {
+            if (index >= node.m_count) {
+                throw Mismatch{};
+            }
+
+            const auto& child = m_nodes[edges[index].m_node];
+            auto*       out   = data + index++ * strides.front();
+
+            switch (child.m_kind) {
+            case Kind::Array: {
+                if (value.type() != T::ARRAY) {
+                    throw Mismatch{};
+                }
+                auto sub = value.get_array().value_unsafe();
+                if (detail::array_size(sub) != child.m_count) {
+                    throw Mismatch{};
+                }
+                write_shaped(child, sub, out, strides.subspan(1));
+                break;
+            }
+            case Kind::Null:
+                if (not value.is_null()) {
+                    throw Mismatch{};
+                }
+                *out = static_cast<Elem>(octave_NaN);
+                break;
+            case Kind::Number:
+                if (auto number = value.get_double(); not number.error()) {
+                    *out = static_cast<Elem>(number.value_unsafe());
+                } else {
+                    throw Mismatch{};
+                }
+                break;
+            case Kind::Bool:
+                if (auto boolean = value.get_bool(); not boolean.error()) {
+                    *out = static_cast<Elem>(boolean.value_unsafe());
+                } else {
+                    throw Mismatch{};
+                }
+                break;
+            default: throw Mismatch{};
+            }
+        }
+    }
+
+    octave_value DecodePlan::decode(simdjson::dom::element elem) const
+    {
+        return decode(m_nodes.front(), elem);
+    }
+
+    octave_value DecodePlan::decode_field(std::size_t field, simdjson::dom::element elem) const
+    {
+        const auto& root = m_nodes.front();
+        if (root.m_kind != Kind::Object or field >= root.m_count) {
+            throw Mismatch{};
+        }
+        return decode(m_nodes[m_edges[root.m_first + field].m_node], elem);
+    }
+
+    octave_value DecodePlan::decode(const Node& node, simdjson::dom::element elem) const
+    {
+        using T = simdjson::dom::element_type;
+
+        switch (node.m_kind) {
+        case Kind::Number:
+            switch (elem.type()) {
+            case T::INT64: return elem.get_int64().value_unsafe();
+            case T::UINT64: return elem.get_uint64().value_unsafe();
+            case T::DOUBLE: return elem.get_double().value_unsafe();
+            default: throw Mismatch{};
+            }
+        case Kind::String:
+            if (elem.type() != T::STRING) {
+                throw Mismatch{};
+            }
+            return detail::decode_string(elem.get_string().value_unsafe());
+        case Kind::Bool:
+            if (elem.type() != T::BOOL) {
+                throw Mismatch{};
+            }
+            return elem.get_bool().value_unsafe();
+        case Kind::Null:
+            if (elem.type() != T::NULL_VALUE) {
+                throw Mismatch{};
+            }
+            return NDArray{};
+        case Kind::Object: return decode_object(node, elem);
+        case Kind::Array: return decode_array(node, elem);
+        default: [[unlikely]] std::abort();
+        }
+    }
+
+    octave_value DecodePlan::decode_object(const Node& node, simdjson::dom::element elem) const
+    {
+        if (elem.type() != simdjson::dom::element_type::OBJECT) {
+            throw Mismatch{};
+        }
+
+        auto shared = node.m_fields != no_fields;
+        auto map    = shared ? octave_scalar_map{ m_fields[node.m_fields] } : octave_scalar_map{};
+        auto edges  = std::span{ m_edges.begin() + static_cast<long>(node.m_first), node.m_count };
+        auto edge   = edges.begin();
+
+        for (auto [key, value] : elem.get_object().value_unsafe()) {
+            if (edge == edges.end() or edge->m_key != key) {
+                throw Mismatch{};
+            }
+
+            if (shared) {
+                map.contents(edge - edges.begin()) = decode(m_nodes[edge->m_node], value);
+            } else {
+                map.assign(edge->m_key, decode(m_nodes[edge->m_node], value));
+            }
+            ++edge;
+        }
+
+        if (edge != edges.end()) {
+            throw Mismatch{};
+        }
+
+        return map;
+    }
+
+    octave_value DecodePlan::decode_array(const Node& node, simdjson::dom::element elem) const
+    {
+        if (elem.type() != simdjson::dom::element_type::ARRAY) {
+            throw Mismatch{};
+        }
+
+        auto array = elem.get_array().value_unsafe();
+        if (detail::array_size(array) != node.m_count) {
+            throw Mismatch{};
+        }
+
+        CancelScope::poll();
+
+        auto edges = std::span{ m_edges.begin() + static_cast<long>(node.m_first), node.m_count };
+        auto dims  = dim_vector(static_cast<long>(node.m_count), 1);
+
+        switch (node.m_array_kind) {
+        case ArrayKind::Empty: return NDArray{};
+        case ArrayKind::Numeric: {
+            auto ndarray = NDArray{ dims };
+            for (auto index = 0ul; auto value : array) {
+                if (index >= node.m_count) {
+                    throw Mismatch{};
+                }
+                if (m_nodes[edges[index].m_node].m_kind == Kind::Null) {
+                    if (not value.is_null()) {
+                        throw Mismatch{};
+                    }
+                    ndarray.xelem(static_cast<long>(index++)) = octave_NaN;
+                } else if (auto number = value.get_double(); not number.error()) {
+                    ndarray.xelem(static_cast<long>(index++)) = number.value_unsafe();
+                } else {
+                    throw Mismatch{};
+                }
+            }
+            return ndarray;
+        }
+        case ArrayKind::Boolean: {
+            auto ndarray = boolNDArray{ dims };
+            for (auto index = 0ul; auto value : array) {
+                if (index >= node.m_count) {
+                    throw Mismatch{};
+                }
+                if (auto boolean = value.get_bool(); not boolean.error()) {
+                    ndarray.xelem(static_cast<long>(index++)) = boolean.value_unsafe();
+                } else {
+                    throw Mismatch{};
+                }
+            }
+            return ndarray;
+        }
+        case ArrayKind::Arrays:
+            // rectangular nesting is written straight into the final N-D array
+            if (node.m_shape != no_shape) {
+                const auto& shape = m_shapes[node.m_shape];
+                if (shape.m_bool) {
+                    auto ndarray = boolNDArray{ shape.m_dims };
+                    write_shaped(node, array, ndarray.fortran_vec(), shape.m_strides);
+                    return ndarray;
+                } else {
+                    auto ndarray = NDArray{ shape.m_dims };
+                    write_shaped(node, array, ndarray.fortran_vec(), shape.m_strides);
+                    return ndarray;
+                }
+            }
+            [[fallthrough]];
+        case ArrayKind::Mixed:
+        case ArrayKind::Objects: {
+            auto cell = Cell{ dims };
+            for (auto index = 0ul; auto value : array) {
+                if (index >= node.m_count) {
+                    throw Mismatch{};
+                }
+                cell.xelem(static_cast<long>(index)) = decode(m_nodes[edges[index].m_node], value);
+                ++index;
+            }
+
+            switch (node.m_array_kind) {
+            case ArrayKind::Objects: return detail::make_object_array(cell);
+            case ArrayKind::Arrays: return detail::make_array_of_arrays(cell);
+            default: return cell;
+            }
+        }
+        default: [[unlikely]] std::abort();
+        }
+    }
+}
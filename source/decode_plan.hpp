@@ -0,0 +1,154 @@
+#pragma once
+
+#include "schema.hpp"
+
+#include <octave/oct-map.h>
+#include <simdjson/dom/element.h>
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+class octave_value;
+
+namespace octave_ndjson
+{
+    /**
+     * @class DecodePlan
+     *
+     * @brief A decoder specialized for a single schema.
+     *
+     * In strict mode all documents must have the same schema as the first one, so the type of every value,
+     * the order of every key, and the length of every array are known beforehand. The plan is compiled from
+     * the reference schema and then used to decode the rest of the documents while validating them at the
+     * same time, in a single pass over the dom. This removes the need of building the schema of each
+     * document and comparing it to the reference schema separately.
+     */
+    class DecodePlan
+    {
+    public:
+        /**
+         * @brief Thrown when the decoded document doesn't follow the plan.
+         *
+         * The message is deliberately short, the caller is expected to create a better report (e.g. by
+         * building the schema of the document and diffing it with the reference).
+         */
+        struct Mismatch : std::runtime_error
+        {
+            Mismatch()
+                : std::runtime_error{ "Mismatched schema" }
+            {
+            }
+        };
+
+        /**
+         * @brief Compile the plan from a schema.
+         *
+         * @param schema The reference schema, must not be empty.
+         */
+        explicit DecodePlan(const Schema& schema);
+
+        /**
+         * @brief Decode a document following the plan.
+         *
+         * @param elem The simdjson dom element.
+         *
+         * @return A parsed octave_value, identical to what `parse_octave_value` would return.
+         *
+         * @throw DecodePlan::Mismatch if the document doesn't follow the plan.
+         * @throw Cancelled if the stop flag of the current `CancelScope` is set.
+         */
+        octave_value decode(simdjson::dom::element elem) const;
+
+        /**
+         * @brief Decode a value of a top-level field following the plan.
+         *
+         * @param field The index of the field (in the order of occurrence) on the reference document.
+         * @param elem The simdjson dom element of the value.
+         *
+         * @throw DecodePlan::Mismatch if the value doesn't follow the plan or the root is not an object.
+         */
+        octave_value decode_field(std::size_t field, simdjson::dom::element elem) const;
+
+    private:
+        enum class Kind : std::uint8_t
+        {
+            Number,
+            String,
+            Bool,
+            Null,
+            Object,
+            Array,
+        };
+
+        // the kind of array determines the conversion, see `detail::decode_array`
+        enum class ArrayKind : std::uint8_t
+        {
+            Empty,
+            Numeric,
+            Boolean,
+            Mixed,
+            Objects,
+            Arrays,
+        };
+
+        struct Node
+        {
+            Kind        m_kind;
+            ArrayKind   m_array_kind;
+            std::size_t m_first;     // index of first edge in `m_edges`
+            std::size_t m_count;     // number of edges (keys or elements)
+            std::size_t m_fields;    // index of the fields in `m_fields` (objects with unique keys only)
+            std::size_t m_shape;     // index of the shape in `m_shapes` (rectangular arrays of arrays only)
+        };
+
+        /**
+         * @brief The N-D array a rectangular array of arrays is written into, the element at [i0]...[in]
+         * goes to (i0, ..., in), same as `detail::decode_array` does.
+         */
+        struct Shape
+        {
+            dim_vector               m_dims;
+            std::vector<std::size_t> m_strides;    // distance between consecutive elements at each level
+            bool                     m_bool;       // the innermost arrays are booleans, numbers otherwise
+        };
+
+        struct Edge
+        {
+            std::string m_key;    // empty for array elements
+            std::size_t m_node;
+        };
+
+        std::size_t compile(Schema::Iterator& it);
+
+        bool infer_shape(
+            const Node&               node,
+            std::size_t               depth,
+            std::vector<std::size_t>& dims,
+            std::optional<bool>&      is_bool
+        ) const;
+
+        template <typename Elem>
+        void write_shaped(
+            const Node&                  node,
+            simdjson::dom::array         array,
+            Elem*                        data,
+            std::span<const std::size_t> strides
+        ) const;
+
+        octave_value decode(const Node& node, simdjson::dom::element elem) const;
+        octave_value decode_object(const Node& node, simdjson::dom::element elem) const;
+        octave_value decode_array(const Node& node, simdjson::dom::element elem) const;
+
+        static constexpr auto no_fields = static_cast<std::size_t>(-1);
+        static constexpr auto no_shape  = static_cast<std::size_t>(-1);
+
+        std::vector<Node>          m_nodes;    // the first node is the root
+        std::vector<Edge>          m_edges;
+        std::vector<octave_fields> m_fields;    // shared by every decoded object of the same node
+        std::vector<Shape>         m_shapes;
+    };
+}
@@ -0,0 +1,277 @@
+#include "decompress.hpp"
+
+#include "thread_pool.hpp"
+
+#include <simdjson.h>
+
+#if defined(NDJSON_HAS_ZLIB)
+#    include <zlib.h>
+#endif
+#if defined(NDJSON_HAS_ZSTD)
+#    include <zstd.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <limits>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+namespace octave_ndjson::detail
+{
+    std::uint32_t read_le32(std::string_view content)
+    {
+        auto bytes = std::array<unsigned char, 4>{};
+        std::memcpy(bytes.data(), content.data(), 4);
+        return bytes[0] | bytes[1] << 8 | bytes[2] << 16 | static_cast<std::uint32_t>(bytes[3]) << 24;
+    }
+
+    /**
+     * @brief Make the capacity of the decompressed content include the simdjson padding.
+     */
+    std::string finish(std::string&& out, std::size_t size)
+    {
+        out.resize(size);
+        out.reserve(size + simdjson::SIMDJSON_PADDING);
+        return std::move(out);
+    }
+
+#if defined(NDJSON_HAS_ZLIB)
+    std::string decompress_gzip(std::string_view content)
+    {
+        auto stream = z_stream{};
+        if (inflateInit2(&stream, 15 + 32) != Z_OK) {    // +32: detect gzip or zlib header
+            throw std::runtime_error{ "Failed to initialize zlib" };
+        }
+        auto guard = std::unique_ptr<z_stream, decltype(&inflateEnd)>{ &stream, inflateEnd };
+
+        // the trailer only has the size (mod 2^32) of the last member, use it as a hint at best
+        auto hint = content.size() >= 4 ? read_le32(content.substr(content.size() - 4)) : 0u;
+        auto out  = std::string(std::max({ std::size_t{ hint }, content.size() * 4, 4096ul }), '\0');
+        auto size = 0ul;
+
+        constexpr auto max_avail = static_cast<std::size_t>(std::numeric_limits<uInt>::max());
+
+        auto in = content;
+        while (true) {
+            if (size == out.size()) {
+                out.resize(out.size() * 2);
+            }
+
+            auto avail_in  = std::min(in.size(), max_avail);
+            auto avail_out = std::min(out.size() - size, max_avail);
+
+            stream.next_in   = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+            stream.avail_in  = static_cast<uInt>(avail_in);
+            stream.next_out  = reinterpret_cast<Bytef*>(out.data() + size);
+            stream.avail_out = static_cast<uInt>(avail_out);
+
+            auto ret = inflate(&stream, Z_NO_FLUSH);
+
+            in.remove_prefix(avail_in - stream.avail_in);
+            size += avail_out - stream.avail_out;
+
+            if (ret == Z_STREAM_END and in.empty()) {
+                break;
+            } else if (ret == Z_STREAM_END) {
+                // concatenated members (e.g. from bgzip or `cat a.gz b.gz`)
+                if (inflateReset(&stream) != Z_OK) {
+                    throw std::runtime_error{ "Failed to reset zlib" };
+                }
+            } else if (ret != Z_OK and ret != Z_BUF_ERROR) {
+                auto what = stream.msg != nullptr ? stream.msg : "unknown error";
+                throw std::runtime_error{ std::format("Corrupted gzip content: {}", what) };
+            } else if (in.empty() and stream.avail_out != 0) {
+                // the whole input is consumed with room left for the output, yet the stream is not ended
+                throw std::runtime_error{ "Corrupted gzip content: truncated" };
+            }
+        }
+
+        return finish(std::move(out), size);
+    }
+#endif
+
+#if defined(NDJSON_HAS_ZSTD)
+    struct ZstdFrame
+    {
+        std::string_view m_content;
+        std::size_t      m_offset;    // in the decompressed content
+        std::size_t      m_size;      // decompressed size
+    };
+
+    bool is_skippable_frame(std::string_view content)
+    {
+        return content.size() >= 4 and (read_le32(content) & 0xFFFFFFF0u) == 0x184D2A50u;
+    }
+
+    /**
+     * @brief Find the frames of the content.
+     *
+     * @return The frames, or empty if the decompressed size of any frame is unknown.
+     */
+    std::vector<ZstdFrame> find_zstd_frames(std::string_view content)
+    {
+        auto frames = std::vector<ZstdFrame>{};
+        auto offset = 0ul;
+
+        while (not content.empty()) {
+            auto compressed = ZSTD_findFrameCompressedSize(content.data(), content.size());
+            if (ZSTD_isError(compressed)) {
+                throw std::runtime_error{ std::format(
+                    "Corrupted zstd content: {}", ZSTD_getErrorName(compressed)
+                ) };
+            }
+
+            // skippable frames carry metadata (e.g. the seek table of the seekable format)
+            if (not is_skippable_frame(content)) {
+                auto size = ZSTD_getFrameContentSize(content.data(), content.size());
+                if (size == ZSTD_CONTENTSIZE_UNKNOWN or size == ZSTD_CONTENTSIZE_ERROR) {
+                    return {};
+                }
+                frames.emplace_back(content.substr(0, compressed), offset, size);
+                offset += size;
+            }
+
+            content.remove_prefix(compressed);
+        }
+
+        return frames;
+    }
+
+    std::string decompress_zstd_frames(std::span<const ZstdFrame> frames, std::size_t concurrency)
+    {
+        auto size = frames.empty() ? 0ul : frames.back().m_offset + frames.back().m_size;
+        auto out  = std::string(size, '\0');
+        auto next = std::atomic<std::size_t>{ 0 };
+
+        ThreadPool::instance().run(std::min(concurrency, frames.size()), [&](std::size_t) {
+            auto context = std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)>{
+                ZSTD_createDCtx(),
+                ZSTD_freeDCtx,
+            };
+            if (context == nullptr) {
+                throw std::runtime_error{ "Failed to initialize zstd" };
+            }
+
+            for (auto i = next++; i < frames.size(); i = next++) {
+                const auto& frame = frames[i];
+
+                auto* dest   = out.data() + frame.m_offset;
+                auto  result = ZSTD_decompressDCtx(
+                    context.get(), dest, frame.m_size, frame.m_content.data(), frame.m_content.size()
+                );
+
+                if (ZSTD_isError(result)) {
+                    throw std::runtime_error{ std::format(
+                        "Corrupted zstd content: {}", ZSTD_getErrorName(result)
+                    ) };
+                } else if (result != frame.m_size) {
+                    throw std::runtime_error{ "Corrupted zstd content: mismatched frame size" };
+                }
+            }
+        });
+
+        return finish(std::move(out), size);
+    }
+
+    std::string decompress_zstd_stream(std::string_view content)
+    {
+        auto stream = std::unique_ptr<ZSTD_DStream, decltype(&ZSTD_freeDStream)>{
+            ZSTD_createDStream(),
+            ZSTD_freeDStream,
+        };
+        if (stream == nullptr) {
+            throw std::runtime_error{ "Failed to initialize zstd" };
+        }
+
+        auto out  = std::string(std::max(content.size() * 4, 4096ul), '\0');
+        auto size = 0ul;
+        auto in   = ZSTD_inBuffer{ content.data(), content.size(), 0 };
+        auto last = 0ul;    // the return value of the last call, 0 means a frame is complete
+
+        while (in.pos < in.size) {
+            if (size == out.size()) {
+                out.resize(out.size() * 2);
+            }
+
+            auto buffer = ZSTD_outBuffer{ out.data() + size, out.size() - size, 0 };
+
+            last = ZSTD_decompressStream(stream.get(), &buffer, &in);
+            if (ZSTD_isError(last)) {
+                throw std::runtime_error{ std::format(
+                    "Corrupted zstd content: {}", ZSTD_getErrorName(last)
+                ) };
+            }
+            size += buffer.pos;
+        }
+
+        // flush what is still buffered in the context
+        while (last != 0) {
+            if (size == out.size()) {
+                out.resize(out.size() * 2);
+            }
+
+            auto buffer = ZSTD_outBuffer{ out.data() + size, out.size() - size, 0 };
+
+            last = ZSTD_decompressStream(stream.get(), &buffer, &in);
+            if (ZSTD_isError(last)) {
+                throw std::runtime_error{ std::format(
+                    "Corrupted zstd content: {}", ZSTD_getErrorName(last)
+                ) };
+            } else if (buffer.pos == 0 and last != 0) {
+                throw std::runtime_error{ "Corrupted zstd content: truncated" };
+            }
+            size += buffer.pos;
+        }
+
+        return finish(std::move(out), size);
+    }
+#endif
+}
+
+namespace octave_ndjson
+{
+    Compression detect_compression(std::string_view content) noexcept
+    {
+        if (content.starts_with("\x1f\x8b")) {
+            return Compression::Gzip;
+        } else if (content.starts_with("\x28\xb5\x2f\xfd")) {
+            return Compression::Zstd;
+        }
+        return Compression::None;
+    }
+
+    std::string decompress(
+        std::string_view             content,
+        Compression                  compression,
+        [[maybe_unused]] std::size_t concurrency
+    )
+    {
+        switch (compression) {
+        case Compression::Gzip:
+#if defined(NDJSON_HAS_ZLIB)
+            return detail::decompress_gzip(content);
+#else
+            throw std::runtime_error{ "gzip input is not supported by this build (zlib was not found)" };
+#endif
+        case Compression::Zstd:
+#if defined(NDJSON_HAS_ZSTD)
+            if (auto frames = detail::find_zstd_frames(content); not frames.empty()) {
+                return detail::decompress_zstd_frames(frames, concurrency);
+            }
+            return detail::decompress_zstd_stream(content);
+#else
+            throw std::runtime_error{ "zstd input is not supported by this build (libzstd was not found)" };
+#endif
+        case Compression::None: break;
+        }
+
+        return detail::finish(std::string{ content }, content.size());
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace octave_ndjson
+{
+    enum class Compression
+    {
+        None,
+        Gzip,
+        Zstd,
+    };
+
+    /**
+     * @brief Detect the compression of a content from its magic number.
+     */
+    Compression detect_compression(std::string_view content) noexcept;
+
+    /**
+     * @brief Decompress a content into memory.
+     *
+     * @param content The compressed content.
+     * @param compression The compression, must not be `Compression::None`.
+     * @param concurrency Number of workers for the formats that can be decompressed in parallel.
+     *
+     * @return The decompressed content, its capacity includes the simdjson padding.
+     *
+     * @throw std::runtime_error if the content is corrupted, or the compression is not supported by this
+     *        build (the library was not found at configure time).
+     *
+     * A zstd content made of multiple frames whose sizes are recorded in their headers (e.g. the seekable
+     * format or the output of `pzstd`) is decompressed frame by frame in parallel, directly into the final
+     * buffer. Anything else (unknown frame sizes, gzip) is decompressed sequentially. Concatenated gzip
+     * members and zstd frames are both supported.
+     */
+    std::string decompress(
+        std::string_view content,
+        Compression      compression,
+        std::size_t      concurrency
+    );
+}
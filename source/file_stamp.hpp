@@ -0,0 +1,36 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+namespace octave_ndjson
+{
+    /**
+     * @brief Identity of the content of a file, used to invalidate what is derived from it.
+     */
+    struct FileStamp
+    {
+        std::uint64_t m_size;
+        std::int64_t  m_mtime;    // in nanoseconds
+
+        bool operator==(const FileStamp&) const = default;
+
+        /**
+         * @brief Get the stamp of a file.
+         *
+         * @throw std::filesystem::filesystem_error if the file can't be queried.
+         */
+        static FileStamp of(const std::string& path)
+        {
+            auto size  = std::filesystem::file_size(path);
+            auto mtime = std::filesystem::last_write_time(path).time_since_epoch();
+
+            return {
+                .m_size  = static_cast<std::uint64_t>(size),
+                .m_mtime = std::chrono::duration_cast<std::chrono::nanoseconds>(mtime).count(),
+            };
+        }
+    };
+}
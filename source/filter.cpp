@@ -0,0 +1,168 @@
+#include "filter.hpp"
+
+#include "util.hpp"
+
+#include <simdjson.h>
+
+#include <algorithm>
+#include <format>
+#include <stdexcept>
+#include <string_view>
+
+namespace octave_ndjson::detail
+{
+    // a scalar of a document, an object or an array is stored as `std::monostate`
+    using Scalar = std::variant<std::monostate, std::nullptr_t, bool, double, std::string_view>;
+
+    bool equals(const Filter::Value& expected, const Scalar& actual)
+    {
+        auto visit = util::Overload{
+            [&](std::nullptr_t) { return std::holds_alternative<std::nullptr_t>(actual); },
+            [&](bool value) {
+                auto* boolean = std::get_if<bool>(&actual);
+                return boolean != nullptr and *boolean == value;
+            },
+            [&](double value) {
+                auto* number = std::get_if<double>(&actual);
+                return number != nullptr and *number == value;
+            },
+            [&](const std::string& value) {
+                auto* string = std::get_if<std::string_view>(&actual);
+                return string != nullptr and *string == value;
+            },
+        };
+        return std::visit(visit, expected);
+    }
+
+    bool test(const Filter::Predicate& predicate, const Scalar& actual)
+    {
+        using Op = Filter::Op;
+
+        auto* number    = std::get_if<double>(&actual);
+        auto* string    = std::get_if<std::string_view>(&actual);
+        auto* threshold = std::get_if<double>(&predicate.m_value);
+        auto* prefix    = std::get_if<std::string>(&predicate.m_value);
+
+        // the constructor ensures the ordering operators have a number and the prefix a string
+        switch (predicate.m_op) {
+        case Op::Equal: return equals(predicate.m_value, actual);
+        case Op::NotEqual: return not equals(predicate.m_value, actual);
+        case Op::Less: return number != nullptr and *number < *threshold;
+        case Op::LessEqual: return number != nullptr and *number <= *threshold;
+        case Op::Greater: return number != nullptr and *number > *threshold;
+        case Op::GreaterEqual: return number != nullptr and *number >= *threshold;
+        case Op::Prefix: return string != nullptr and string->starts_with(*prefix);
+        }
+
+        return false;
+    }
+
+    Scalar to_scalar(simdjson::dom::element elem)
+    {
+        using T = simdjson::dom::element_type;
+        switch (elem.type()) {
+        case T::INT64:
+        case T::UINT64:
+        case T::DOUBLE: return elem.get_double().value_unsafe();
+        case T::STRING: return elem.get_string().value_unsafe();
+        case T::BOOL: return elem.get_bool().value_unsafe();
+        case T::NULL_VALUE: return nullptr;
+        default: return std::monostate{};
+        }
+    }
+
+    Scalar to_scalar(simdjson::ondemand::value value)
+    {
+        using T = simdjson::ondemand::json_type;
+        switch (value.type().value()) {
+        case T::number: return value.get_double().value();
+        case T::string: return value.get_string().value();
+        case T::boolean: return value.get_bool().value();
+        case T::null: value.is_null().value(); return nullptr;
+        default: return std::monostate{};
+        }
+    }
+}
+
+namespace octave_ndjson
+{
+    Filter::Filter(std::vector<Predicate> predicates)
+        : m_predicates{ std::move(predicates) }
+    {
+        if (m_predicates.empty()) {
+            throw std::invalid_argument{ "At least one predicate is required" };
+        }
+
+        for (const auto& [path, op, value] : m_predicates) {
+            auto& keys = m_keys.emplace_back();
+
+            for (auto begin = 0ul; begin <= path.size();) {
+                auto end = std::min(path.find('.', begin), path.size());
+                if (end == begin) {
+                    throw std::invalid_argument{ std::format("Invalid field '{}'", path) };
+                }
+                keys.emplace_back(path.substr(begin, end - begin));
+                begin = end + 1;
+            }
+
+            auto ordering = op != Op::Equal and op != Op::NotEqual and op != Op::Prefix;
+            if (ordering and not std::holds_alternative<double>(value)) {
+                throw std::invalid_argument{ std::format("Field '{}' must be compared to a number", path) };
+            } else if (op == Op::Prefix and not std::holds_alternative<std::string>(value)) {
+                throw std::invalid_argument{ std::format("Prefix of field '{}' must be a string", path) };
+            }
+        }
+    }
+
+    bool Filter::matches(simdjson::dom::element elem) const
+    {
+        for (auto i = 0ul; i < m_predicates.size(); ++i) {
+            auto value = elem;
+            for (const auto& key : m_keys[i]) {
+                auto next = value.get_object().at_key(key);
+                if (next.error()) {
+                    return false;
+                }
+                value = next.value_unsafe();
+            }
+
+            if (not detail::test(m_predicates[i], detail::to_scalar(value))) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool Filter::matches(simdjson::ondemand::document_reference doc) const
+    {
+        auto result = true;
+
+        // each lookup starts from the beginning of the document since the predicates are in any order
+        for (auto i = 0ul; i < m_predicates.size() and result; ++i) {
+            doc.rewind();
+
+            auto object = doc.get_object();
+            if (object.error() == simdjson::INCORRECT_TYPE) {
+                result = false;
+                break;
+            }
+
+            auto value = object.find_field_unordered(m_keys[i].front());
+            for (const auto& key : std::span{ m_keys[i] }.subspan(1)) {
+                value = value.find_field_unordered(key);
+            }
+
+            // a missing field or a non-object on the path
+            if (value.error() == simdjson::NO_SUCH_FIELD or value.error() == simdjson::INCORRECT_TYPE) {
+                result = false;
+                break;
+            }
+
+            result = detail::test(m_predicates[i], detail::to_scalar(value.value()));
+        }
+
+        doc.rewind();
+        return result;
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <simdjson/dom/element.h>
+#include <simdjson/ondemand.h>
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace octave_ndjson
+{
+    /**
+     * @class Filter
+     *
+     * @brief Predicates on the fields of a document, only the documents that satisfy all of them are kept.
+     *
+     * The predicates are evaluated on the parsed JSON value, before anything is decoded, so a rejected
+     * document costs its parsing only. A field is specified by its path, the keys from the root joined by a
+     * dot, same as `Projection`.
+     *
+     * A document without the field never matches. A field with a different type than the value is not
+     * equal to it, the ordering operators only apply to numbers and the prefix operator only to strings.
+     */
+    class Filter
+    {
+    public:
+        enum class Op
+        {
+            Equal,
+            NotEqual,
+            Less,
+            LessEqual,
+            Greater,
+            GreaterEqual,
+            Prefix,
+        };
+
+        // the value the field is compared against, null is stored as `nullptr`
+        using Value = std::variant<std::nullptr_t, bool, double, std::string>;
+
+        struct Predicate
+        {
+            std::string m_path;
+            Op          m_op;
+            Value       m_value;
+        };
+
+        /**
+         * @brief Create a filter from a list of predicates.
+         *
+         * @param predicates The predicates, a document must satisfy all of them.
+         *
+         * @throw std::invalid_argument if there is no predicate, a path is empty or malformed, or the value
+         *        doesn't apply to the operator.
+         */
+        explicit Filter(std::vector<Predicate> predicates);
+
+        /**
+         * @brief Check whether a document satisfies the predicates.
+         *
+         * @param elem The simdjson dom element.
+         */
+        bool matches(simdjson::dom::element elem) const;
+
+        /**
+         * @brief Check whether a document satisfies the predicates.
+         *
+         * @param doc The simdjson On-Demand document, rewound afterwards so it can be decoded from the start.
+         *
+         * @throw simdjson::simdjson_error on parsing error.
+         */
+        bool matches(simdjson::ondemand::document_reference doc) const;
+
+        std::span<const Predicate> predicates() const noexcept { return m_predicates; }
+
+    private:
+        std::vector<Predicate>                m_predicates;
+        std::vector<std::vector<std::string>> m_keys;    // the path of each predicate split into keys
+    };
+}
@@ -0,0 +1,138 @@
+#include "line_index.hpp"
+
+#include "util.hpp"
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+
+namespace octave_ndjson::detail
+{
+    namespace fs = std::filesystem;
+
+    constexpr auto index_magic = std::array{ 'N', 'D', 'J', 'S', 'O', 'N', 'X', '1' };
+
+    struct IndexHeader
+    {
+        std::array<char, 8> m_magic;
+        std::uint64_t       m_size;
+        std::int64_t        m_mtime;
+        std::uint64_t       m_stride;
+        std::uint64_t       m_lines;
+        std::uint64_t       m_count;    // number of offsets following the header
+    };
+}
+
+namespace octave_ndjson
+{
+    LineIndex::LineIndex(std::string_view content, FileStamp stamp, std::size_t stride)
+        : m_stamp{ stamp }
+        , m_stride{ std::max(stride, 1ul) }
+    {
+        m_offsets.reserve(util::count_split(content, '\n') / m_stride + 1);
+
+        auto splitter = util::StringSplitter{ content, '\n' };
+        while (auto line = splitter.next()) {
+            if (m_lines % m_stride == 0) {
+                m_offsets.push_back(static_cast<std::uint64_t>(line->data() - content.data()));
+            }
+            ++m_lines;
+        }
+    }
+
+    std::optional<LineIndex> LineIndex::load(const std::string& path, FileStamp stamp)
+    {
+        auto file = std::ifstream{ path, std::ios::binary };
+        if (not file) {
+            return std::nullopt;
+        }
+
+        auto header = detail::IndexHeader{};
+        if (not file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+            return std::nullopt;
+        }
+
+        auto valid = header.m_magic == detail::index_magic
+                 and FileStamp{ header.m_size, header.m_mtime } == stamp
+                 and header.m_stride != 0
+                 and header.m_count == (header.m_lines + header.m_stride - 1) / header.m_stride;
+
+        if (not valid) {
+            return std::nullopt;
+        }
+
+        auto index     = LineIndex{};
+        index.m_stamp  = stamp;
+        index.m_stride = header.m_stride;
+        index.m_lines  = header.m_lines;
+        index.m_offsets.resize(header.m_count);
+
+        auto bytes = static_cast<std::streamsize>(header.m_count * sizeof(std::uint64_t));
+        if (not file.read(reinterpret_cast<char*>(index.m_offsets.data()), bytes)) {
+            return std::nullopt;
+        }
+
+        return index;
+    }
+
+    void LineIndex::save(const std::string& path) const
+    {
+        auto header = detail::IndexHeader{
+            .m_magic  = detail::index_magic,
+            .m_size   = m_stamp.m_size,
+            .m_mtime  = m_stamp.m_mtime,
+            .m_stride = m_stride,
+            .m_lines  = m_lines,
+            .m_count  = m_offsets.size(),
+        };
+
+        auto temp = path + ".tmp";
+        {
+            auto file  = std::ofstream{ temp, std::ios::binary | std::ios::trunc };
+            auto bytes = static_cast<std::streamsize>(m_offsets.size() * sizeof(std::uint64_t));
+
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(m_offsets.data()), bytes);
+            file.close();
+
+            if (not file) {
+                auto ec = std::error_code{};
+                detail::fs::remove(temp, ec);
+                throw std::system_error{ std::make_error_code(std::errc::io_error), "write index" };
+            }
+        }
+
+        detail::fs::rename(temp, path);
+    }
+
+    std::string_view LineIndex::slice(std::string_view content, std::size_t first, std::size_t last) const
+    {
+        last = std::min(last, m_lines);
+        if (first >= last) {
+            return {};
+        }
+
+        // scan from the nearest entry, at most `m_stride` lines are skipped
+        auto entry    = first / m_stride;
+        auto offset   = static_cast<std::size_t>(m_offsets[entry]);
+        auto splitter = util::StringSplitter{ content.substr(offset), '\n' };
+
+        for (auto skip = first - entry * m_stride; skip > 0; --skip) {
+            splitter.next();
+        }
+
+        auto begin = splitter.next().value();
+        auto end   = begin;
+        for (auto line = first + 1; line < last; ++line) {
+            end = splitter.next().value();
+        }
+
+        // include the newline of the last line, if any
+        auto from = static_cast<std::size_t>(begin.data() - content.data());
+        auto to   = static_cast<std::size_t>(end.data() - content.data()) + end.size();
+
+        return content.substr(from, std::min(to + 1, content.size()) - from);
+    }
+}
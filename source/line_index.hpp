@@ -0,0 +1,89 @@
+#pragma once
+
+#include "file_stamp.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace octave_ndjson
+{
+    /**
+     * @class LineIndex
+     *
+     * @brief Sparse index of the byte offset of the lines of a JSONL file.
+     *
+     * Only the offset of every `stride`-th line is stored, so the index stays small (a few hundred KB for
+     * hundreds of millions of lines) while a line can still be found by scanning at most `stride` lines from
+     * the nearest entry. Empty lines are skipped, same as `load_multi`, so the line numbering matches the
+     * document numbering.
+     *
+     * The index can be saved next to the file and loaded back later, it is invalidated when the size or
+     * the modification time of the file changes.
+     */
+    class LineIndex
+    {
+    public:
+        static constexpr auto default_stride = 4096ul;
+
+        /**
+         * @brief Build the index by scanning the content of the file.
+         *
+         * @param content The content of the file.
+         * @param stamp The stamp of the file.
+         * @param stride Distance (in lines) between consecutive entries.
+         */
+        LineIndex(std::string_view content, FileStamp stamp, std::size_t stride = default_stride);
+
+        /**
+         * @brief Load an index saved by `save`.
+         *
+         * @param path Path to the index file.
+         * @param stamp The current stamp of the indexed file.
+         *
+         * @return The index, or `std::nullopt` if it doesn't exist, is malformed, or is stale.
+         */
+        static std::optional<LineIndex> load(const std::string& path, FileStamp stamp);
+
+        /**
+         * @brief Save the index to a file.
+         *
+         * @param path Path to the index file.
+         *
+         * @throw std::system_error if the file can't be written.
+         *
+         * The index is written to a temporary file first then renamed, so a concurrent `load` never sees a
+         * partially written index.
+         */
+        void save(const std::string& path) const;
+
+        /**
+         * @brief Get the part of the content that contains a range of lines.
+         *
+         * @param content The content of the indexed file.
+         * @param first Index of the first line (0-based).
+         * @param last One past the index of the last line, clamped to the number of lines.
+         *
+         * @return The lines with their newlines, empty if `first` is not less than `last`.
+         */
+        std::string_view slice(std::string_view content, std::size_t first, std::size_t last) const;
+
+        std::size_t lines() const noexcept { return m_lines; }
+
+        /**
+         * @brief Get the default path of the index of a file (the path with `.idx` appended).
+         */
+        static std::string path_for(const std::string& path) { return path + ".idx"; }
+
+    private:
+        LineIndex() = default;
+
+        FileStamp                  m_stamp  = {};
+        std::size_t                m_stride = default_stride;
+        std::size_t                m_lines  = 0;
+        std::vector<std::uint64_t> m_offsets;    // offset of the lines 0, stride, 2 * stride, ...
+    };
+}
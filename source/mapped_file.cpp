@@ -0,0 +1,126 @@
+#include "mapped_file.hpp"
+
+#include <simdjson.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <system_error>
+#include <utility>
+
+namespace octave_ndjson::detail
+{
+    /**
+     * @brief RAII wrapper for file descriptor.
+     */
+    struct FileDescriptor
+    {
+        int m_fd;
+
+        ~FileDescriptor()
+        {
+            if (m_fd >= 0) {
+                ::close(m_fd);
+            }
+        }
+    };
+
+    [[noreturn]] void throw_errno(const char* what)
+    {
+        throw std::system_error{ errno, std::generic_category(), what };
+    }
+}
+
+namespace octave_ndjson
+{
+    MappedFile::MappedFile(const std::string& path)
+    {
+        auto fd = detail::FileDescriptor{ ::open(path.c_str(), O_RDONLY | O_CLOEXEC) };
+        if (fd.m_fd < 0) {
+            detail::throw_errno("open");
+        }
+
+        struct stat st = {};
+        if (::fstat(fd.m_fd, &st) < 0) {
+            detail::throw_errno("fstat");
+        }
+
+        auto page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        auto size = static_cast<std::size_t>(st.st_size);
+
+        m_size     = size;
+        m_capacity = (size + simdjson::SIMDJSON_PADDING + page - 1) / page * page;
+
+        // reserve the whole region first, anonymous mapping is zero-filled
+        auto* region = ::mmap(nullptr, m_capacity, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (region == MAP_FAILED) {
+            detail::throw_errno("mmap");
+        }
+        m_data = static_cast<char*>(region);
+
+        if (size == 0) {
+            return;
+        }
+
+        // then map the file on top of it, the remainder of the last page of the file is zero-filled by the
+        // kernel while the pages after it stay anonymous
+        auto* file = ::mmap(region, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd.m_fd, 0);
+        if (file == MAP_FAILED) {
+            auto err = errno;
+            unmap();
+            throw std::system_error{ err, std::generic_category(), "mmap" };
+        }
+
+        // each thread reads its own range sequentially, let the kernel read ahead aggressively
+        ::madvise(region, size, MADV_SEQUENTIAL);
+    }
+
+    MappedFile::~MappedFile()
+    {
+        unmap();
+    }
+
+    MappedFile::MappedFile(MappedFile&& other) noexcept
+        : m_data{ std::exchange(other.m_data, nullptr) }
+        , m_size{ std::exchange(other.m_size, 0) }
+        , m_capacity{ std::exchange(other.m_capacity, 0) }
+    {
+    }
+
+    MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+    {
+        if (this != &other) {
+            unmap();
+            m_data     = std::exchange(other.m_data, nullptr);
+            m_size     = std::exchange(other.m_size, 0);
+            m_capacity = std::exchange(other.m_capacity, 0);
+        }
+        return *this;
+    }
+
+    void MappedFile::unmap() noexcept
+    {
+        if (m_data != nullptr) {
+            ::munmap(m_data, m_capacity);
+            m_data = nullptr;
+        }
+    }
+
+    void prefetch(std::string_view range) noexcept
+    {
+        if (range.empty()) {
+            return;
+        }
+
+        // madvise requires a page aligned address
+        auto page  = static_cast<std::uintptr_t>(::sysconf(_SC_PAGESIZE));
+        auto begin = reinterpret_cast<std::uintptr_t>(range.data()) / page * page;
+        auto end   = reinterpret_cast<std::uintptr_t>(range.data() + range.size());
+
+        ::madvise(reinterpret_cast<void*>(begin), end - begin, MADV_WILLNEED);
+    }
+}
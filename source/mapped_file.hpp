@@ -0,0 +1,65 @@
+#pragma once
+
+#include <simdjson/padded_string_view.h>
+
+#include <string>
+#include <string_view>
+
+namespace octave_ndjson
+{
+    /**
+     * @class MappedFile
+     *
+     * @brief Read-only memory mapped file with simdjson padding at the end.
+     *
+     * The file is mapped instead of read so the content is paged in lazily by whichever thread touches it
+     * first, and the memory is backed by the page cache instead of a private heap copy. The padding needed
+     * by simdjson is provided by reserving an anonymous (zero-filled) region that is slightly larger than
+     * the file and mapping the file on top of it, so reading past the end of file never touches a page that
+     * is not backed by anything (which would raise SIGBUS).
+     */
+    class MappedFile
+    {
+    public:
+        /**
+         * @brief Map a file into memory.
+         *
+         * @param path Path to the file.
+         *
+         * @throw std::system_error if the file can't be opened or mapped.
+         */
+        explicit MappedFile(const std::string& path);
+
+        ~MappedFile();
+
+        MappedFile(MappedFile&& other) noexcept;
+        MappedFile& operator=(MappedFile&& other) noexcept;
+
+        MappedFile(const MappedFile&)            = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        simdjson::padded_string_view view() const noexcept
+        {
+            return simdjson::padded_string_view{ m_data, m_size, m_capacity };
+        }
+
+        std::size_t size() const noexcept { return m_size; }
+
+    private:
+        void unmap() noexcept;
+
+        char*       m_data     = nullptr;
+        std::size_t m_size     = 0;    // size of the file
+        std::size_t m_capacity = 0;    // size of the mapping, includes the padding
+    };
+
+    /**
+     * @brief Ask the kernel to start reading a range of memory in the background.
+     *
+     * @param range The range, usually part of the view of a `MappedFile`.
+     *
+     * Returns right away, so the pages can be read from the disk while the caller does something else. Has
+     * no effect on memory that is not backed by a file (e.g. a heap string), errors are ignored.
+     */
+    void prefetch(std::string_view range) noexcept;
+}
@@ -0,0 +1,57 @@
+#include "args.hpp"
+#include "ndjson_load.hpp"
+#include "ndjson_save.hpp"
+
+#include <octave/defun-dld.h>
+#include <octave/error.h>
+
+#include <stdexcept>
+
+static constexpr auto usage_string = R"(
+ndjson_dump_string(
+    value     : any,            % positional
+    [threads  : integer]        % optional property
+)
+)";
+
+static constexpr auto help_string = R"(
+============================== ndjson_dump_string help page ==============================
+signature:
+    ndjson_dump_string(
+        value     : any,            % positional
+        [threads  : integer]        % optional property
+    )
+
+parameters:
+    > value : The value to be encoded. Each element of a struct array or a cell array is
+              encoded as a document, anything else (including a scalar struct) as a single
+              document.
+
+    > threads : Number of threads used to encode the documents. Must be a positive integer.
+                Defaults to half of the available hardware threads.
+
+behavior:
+    Encode a value as an NDJSON/JSON Lines string, one document per line, each line ends
+    with a newline. Same as [ndjson_save_file] but the result is returned as a string, see
+    its help page for how the values are encoded.
+
+example:
+    ```
+        octave> s = ndjson_dump_string(struct('a', {1, 2}));
+        octave> % s is "{"a":1}\n{"a":2}\n"
+    ```
+==========================================================================================
+)";
+
+namespace ndjson = octave_ndjson;
+
+DEFUN_DLD(ndjson_dump_string, args, , usage_string)
+{
+    auto [path, value, threads] = ndjson::args::parse_save(args, ndjson::args::Kind::String, help_string);
+
+    try {
+        return octave_value{ ndjson::dump(args(value), ndjson::concurrency(threads)) };
+    } catch (const std::runtime_error& e) {
+        error("Failed to encode the value: %s", e.what());
+    }
+}
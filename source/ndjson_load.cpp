@@ -1,15 +1,35 @@
 #include "ndjson_load.hpp"
 
+#include "arena.hpp"
+#include "cancel.hpp"
+#include "columnar.hpp"
+#include "decode_plan.hpp"
+#include "mapped_file.hpp"
 #include "parse_octave_value.hpp"
+#include "progress.hpp"
 #include "schema.hpp"
+#include "stats.hpp"
+#include "thread_pool.hpp"
 #include "util.hpp"
 
 #include <octave/error.h>
 #include <octave/ov.h>
+#include <octave/quit.h>
 #include <simdjson.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
 #include <format>
+#include <functional>
+#include <numeric>
+#include <optional>
+#include <span>
 #include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 namespace octave_ndjson::detail
@@ -74,19 +94,734 @@ namespace octave_ndjson::detail
         }
     }
 
-}
+    /**
+     * @brief Build a schema from the selected fields of a document.
+     *
+     * @param schema The schema out parameter.
+     * @param fields The selected fields.
+     *
+     * The fields are treated as an object with the paths as its keys.
+     */
+    void build_schema(Schema& schema, std::span<const Projection::Field> fields)
+    {
+        schema.push(Schema::Object::Begin);
+        for (auto [key, value] : fields) {
+            schema.push(Schema::Key{ key });
+            build_schema(schema, value);
+        }
+        schema.push(Schema::Object::End);
+    }
 
-namespace octave_ndjson
-{
-    namespace sv = std::views;
+    /**
+     * @brief Build a schema from a document, or from its selected fields if projection is used.
+     */
+    void build_schema(
+        Schema&                            schema,
+        simdjson::dom::element             elem,
+        std::span<const Projection::Field> fields,
+        const Projection*                  projection
+    )
+    {
+        if (projection != nullptr) {
+            build_schema(schema, fields);
+        } else {
+            build_schema(schema, elem);
+        }
+    }
+
+    /**
+     * @brief Decode the selected fields of a document into a (nested) scalar struct.
+     *
+     * @param projection The projection the fields are selected with.
+     * @param fields The selected fields.
+     * @param plan Decode plan compiled from the schema of the selected fields (strict mode only).
+     *
+     * @throw DecodePlan::Mismatch if `plan` is provided and the fields don't follow it.
+     */
+    octave_value decode_fields(
+        const Projection&                  projection,
+        std::span<const Projection::Field> fields,
+        const DecodePlan*                  plan
+    )
+    {
+        thread_local auto values = std::vector<octave_value>{};
+
+        values.resize(fields.size());
+        for (auto i = 0ul; i < fields.size(); ++i) {
+            auto value = fields[i].m_value;
+            values[i]  = plan ? plan->decode_field(i, value) : parse_octave_value(value);
+        }
+
+        auto map = projection.nest(values);
+        values.clear();
+        return map;
+    }
+
+    /**
+     * @brief Run tasks on multiple threads, each thread takes the next unprocessed task until none left.
+     *
+     * @param concurrency Number of threads.
+     * @param count Number of tasks.
+     * @param fn The function to run, called with the thread index and the task index.
+     * @param poll Called periodically on the calling thread while the tasks run (see `ThreadPool::run`).
+     *
+     * Since the tasks are taken dynamically, a thread that got a slow task doesn't hold the others back.
+     */
+    template <typename Fn>
+    void run_tasks(std::size_t concurrency, std::size_t count, Fn&& fn, std::function<void()> poll = {})
+    {
+        auto next = std::atomic<std::size_t>{ 0 };
+
+        auto task_fn = [&](std::size_t thread) {
+            for (auto task = next++; task < count; task = next++) {
+                fn(thread, task);
+            }
+        };
+        ThreadPool::instance().run(std::min(concurrency, count), task_fn, std::move(poll));
+    }
+
+    /**
+     * @brief Lines of a window of the input, cut into chunks that can be parsed independently.
+     */
+    struct LineChunks
+    {
+        std::vector<std::string_view> m_chunks;
+        std::vector<std::size_t>      m_offsets;    // row of the first line of each chunk, then the end row
+    };
+
+    /**
+     * @brief Cut a window of the input into many small chunks aligned to newline, the lines are not counted.
+     *
+     * @param window The window.
+     * @param concurrency Number of threads.
+     *
+     * The threads then take the chunks one by one, so a chunk with long lines is compensated by the thread
+     * processing more of the other chunks. The lines are counted next (`count_lines`, in parallel) and the
+     * rows numbered (`number_lines`), so the row of each line is known before parsing.
+     */
+    LineChunks cut_lines(std::string_view window, std::size_t concurrency)
+    {
+        static constexpr auto chunks_per_thread = 64ul;
+        static constexpr auto min_chunk_size    = 64ul * 1024;
+
+        auto num_chunks = std::clamp(window.size() / min_chunk_size, 1ul, concurrency * chunks_per_thread);
+        auto chunks     = util::split_chunks(window, num_chunks, '\n');
+        auto offsets    = std::vector<std::size_t>(chunks.size() + 1, 0);
+
+        return { std::move(chunks), std::move(offsets) };
+    }
+
+    /**
+     * @brief Count the lines of a chunk (see `cut_lines`), chunks can be counted from multiple threads.
+     */
+    void count_lines(LineChunks& split, std::size_t chunk)
+    {
+        split.m_offsets[chunk + 1] = util::count_split(split.m_chunks[chunk], '\n');
+    }
 
-    octave_value load(simdjson::padded_string_view string, ParseMode mode)
+    /**
+     * @brief Turn the counted lines of the chunks into their rows (see `cut_lines`).
+     *
+     * @param split The counted chunks.
+     * @param first_row Row of the first line of the window.
+     */
+    void number_lines(LineChunks& split, std::size_t first_row)
     {
-        auto parser       = simdjson::dom::parser{};
-        auto maybe_stream = parser.parse_many(
-            string.data(), string.size(), simdjson::dom::DEFAULT_BATCH_SIZE
+        auto& offsets = split.m_offsets;
+
+        offsets.front() = first_row;
+        std::inclusive_scan(offsets.begin() + 1, offsets.end(), offsets.begin() + 1, std::plus{}, first_row);
+    }
+
+    /**
+     * @brief Cut a window of the input into chunks and count their lines (see `cut_lines`).
+     *
+     * @param window The window.
+     * @param first_row Row of the first line of the window.
+     * @param concurrency Number of threads.
+     */
+    LineChunks split_lines(std::string_view window, std::size_t first_row, std::size_t concurrency)
+    {
+        auto split = cut_lines(window, concurrency);
+
+        run_tasks(concurrency, split.m_chunks.size(), [&](std::size_t, std::size_t chunk) {
+            count_lines(split, chunk);
+        });
+        number_lines(split, first_row);
+
+        return split;
+    }
+
+    /**
+     * @brief Get the parser of the current thread.
+     *
+     * The parser is kept alive with the thread (the threads of the pool are persistent), so its internal
+     * buffers, which grow to fit the largest document seen, don't need to be reallocated on every call.
+     */
+    simdjson::dom::parser& thread_parser()
+    {
+        thread_local auto parser = simdjson::dom::parser{};
+        return parser;
+    }
+
+    /**
+     * @brief Get the On-Demand parser of the current thread (see `thread_parser`).
+     */
+    simdjson::ondemand::parser& thread_ondemand_parser()
+    {
+        thread_local auto parser = simdjson::ondemand::parser{};
+        return parser;
+    }
+
+    /**
+     * @brief The buffers a worker uses while parsing its lines, only meaningful within a line.
+     */
+    struct Scratch
+    {
+        Schema                         m_schema = Schema{ 0 };
+        std::vector<Projection::Field> m_fields;
+        std::vector<std::string_view>  m_keys;
+    };
+
+    /**
+     * @brief Get the scratch buffers of the current thread (see `thread_parser`).
+     *
+     * Reusing them across chunks and calls means a worker stops allocating once the buffers fit the largest
+     * line it has seen.
+     */
+    Scratch& thread_scratch()
+    {
+        thread_local auto scratch = Scratch{};
+        return scratch;
+    }
+
+    /**
+     * @brief Get the counters of a thread, or null if the stats are not collected.
+     */
+    Stats::Counters* stats_counters(Stats* stats, std::size_t thread) noexcept
+    {
+        return stats != nullptr ? &stats->counters(thread) : nullptr;
+    }
+
+    /**
+     * @brief Get the wall time of a phase, or null if the stats are not collected.
+     */
+    Stats::Duration* stats_wall(Stats* stats, Stats::Phase phase) noexcept
+    {
+        return stats != nullptr ? &stats->wall(phase) : nullptr;
+    }
+
+    /**
+     * @brief Get a document of a document stream.
+     *
+     * @param result The document or the error of the stream.
+     * @param batch_size The batch size of the stream.
+     *
+     * @throw simdjson::simdjson_error on parsing error.
+     * @throw std::runtime_error if the document is larger than the batch size.
+     */
+    template <typename T>
+    T stream_document(simdjson::simdjson_result<T> result, std::size_t batch_size)
+    {
+        if (result.error() == simdjson::CAPACITY) {
+            throw std::runtime_error{ std::format(
+                "{} (a document larger than {} bytes needs a larger 'batch_size')",
+                simdjson::error_message(simdjson::CAPACITY),
+                batch_size
+            ) };
+        }
+        return result.value();
+    }
+
+    /**
+     * @brief Get the line of a string that contains an offset.
+     *
+     * @param string The string.
+     * @param offset The offset, clamped to the size of the string.
+     *
+     * @return The line without the newline.
+     */
+    std::string_view line_at(std::string_view string, std::size_t offset) noexcept
+    {
+        offset = std::min(offset, string.size());
+
+        auto begin = offset == 0 ? std::string_view::npos : string.rfind('\n', offset - 1);
+        auto end   = std::min(string.find('\n', offset), string.size());
+
+        begin = begin == std::string_view::npos ? 0 : begin + 1;
+        return string.substr(begin, end - begin);
+    }
+
+    /**
+     * @brief Report a parsing error that happened at an offset of the input string.
+     *
+     * @param string The input string.
+     * @param offset The offset of the document where the error happened.
+     * @param what The error message.
+     *
+     * @throw <internal_octave_error> always.
+     */
+    [[noreturn]] void offset_error(std::string_view string, std::size_t offset, const char* what)
+    {
+        auto to_end = string.size() - offset;
+        auto substr = escape_whitespace({ string.data() + offset, std::min(to_end, 50ul) });
+
+        auto message = std::format(
+            "Parsing error\n"
+            "\t> {}\n\n"
+            "\t> around: [{}\033[1;33m{}\033[00m{}] (at offset: {})\n"
+            "\t                ^\n"
+            "\t                |\n"
+            "\t  parsing ends here",
+            what,
+            offset > 0 ? " ... " : "<bof>",
+            substr,
+            to_end > 50ul ? " ... " : "<eof>",
+            offset
         );
 
+        error("%s", message.c_str());
+    }
+
+    /**
+     * @brief Gather the fields of the decoded documents into a struct array.
+     *
+     * @param docs The decoded documents, scalar structs with the same keys in the same order.
+     * @param keys The keys of the documents.
+     * @param concurrency Number of threads.
+     * @param fill_missing Whether the documents may have any subset of the keys in any order (union mode),
+     *                     the missing fields are filled with [].
+     *
+     * Each task fills a range of rows of every field, so each document is unpacked only once (instead of
+     * once per field) and the columns are written directly through their data pointer.
+     */
+    octave_map make_struct_array(
+        std::span<const octave_value> docs,
+        const string_vector&          keys,
+        std::size_t                   concurrency,
+        bool                          fill_missing = false
+    )
+    {
+        static constexpr auto rows_per_task = 4096ul;
+
+        auto dims   = dim_vector{ static_cast<long>(docs.size()), 1 };
+        auto fields = std::vector<Cell>{};
+        auto data   = std::vector<octave_value*>{};
+
+        for (auto i = 0l; i < keys.numel(); ++i) {
+            data.push_back(fields.emplace_back(dims).fortran_vec());
+        }
+
+        auto fill_fn = [&](std::size_t, std::size_t task) {
+            auto end = std::min((task + 1) * rows_per_task, docs.size());
+            for (auto k = task * rows_per_task; k < end; ++k) {
+                auto map = docs[k].scalar_map_value();
+                for (auto i = 0ul; i < data.size() and not fill_missing; ++i) {
+                    data[i][k] = std::move(map.contents(static_cast<long>(i)));
+                }
+                for (auto i = 0ul; i < data.size() and fill_missing; ++i) {
+                    auto value = map.getfield(keys(static_cast<long>(i)));
+                    data[i][k] = value.is_defined() ? std::move(value) : NDArray{};
+                }
+            }
+        };
+
+        auto tasks = (docs.size() + rows_per_task - 1) / rows_per_task;
+        if (concurrency > 1) {
+            run_tasks(concurrency, tasks, fill_fn);
+        } else {
+            for (auto task = 0ul; task < tasks; ++task) {
+                fill_fn(0, task);
+            }
+        }
+
+        auto struct_array = octave_map{};
+        for (auto i = 0l; i < keys.numel(); ++i) {
+            struct_array.assign(keys(i), fields[static_cast<std::size_t>(i)]);
+        }
+        return struct_array;
+    }
+
+    /**
+     * @brief Drop the rows that don't match the filter.
+     *
+     * @param kept Whether each row matches the filter.
+     * @param cell The decoded rows (rows layout), compacted in place.
+     * @param columnar The decoded columns (columnar layout), compacted in place if set.
+     *
+     * @return Number of rows kept.
+     */
+    std::size_t keep_rows(const std::vector<char>& kept, Cell& cell, std::optional<Columnar>& columnar)
+    {
+        auto rows = std::vector<std::size_t>{};
+        for (auto row = 0ul; row < kept.size(); ++row) {
+            if (kept[row]) {
+                rows.push_back(row);
+            }
+        }
+
+        if (columnar.has_value()) {
+            columnar->keep(rows);
+            return rows.size();
+        }
+
+        // the rows are increasing, so each row is moved to the same or an earlier position
+        auto* data = cell.fortran_vec();
+        for (auto i = 0ul; i < rows.size(); ++i) {
+            if (rows[i] != i) {
+                data[i] = std::move(data[rows[i]]);
+            }
+        }
+        cell.resize(dim_vector(static_cast<long>(rows.size()), 1));
+
+        return rows.size();
+    }
+
+    /**
+     * @brief Whether the documents are checked against the reference schema in a parse mode.
+     */
+    constexpr bool checks_schema(ParseMode mode) noexcept
+    {
+        return mode != ParseMode::Relaxed and mode != ParseMode::Union;
+    }
+
+    /**
+     * @class KeyUnion
+     *
+     * @brief Union of the top-level keys of the documents in the order of their first occurrence (union
+     * mode).
+     *
+     * Documents usually repeat the same keys, so the keys of the previous document are kept and a document
+     * with the exact same keys is only compared against them.
+     */
+    class KeyUnion
+    {
+    public:
+        /**
+         * @brief Add the keys of a document.
+         *
+         * @param keys The keys, or `std::nullopt` if the document is not an object.
+         */
+        void add(std::optional<std::span<const std::string_view>> keys)
+        {
+            if (not keys) {
+                m_objects = false;
+                return;
+            } else if (std::ranges::equal(*keys, m_last)) {
+                return;
+            }
+
+            m_last.assign(keys->begin(), keys->end());
+            for (auto key : *keys) {
+                insert(key);
+            }
+        }
+
+        /**
+         * @brief Add the keys of another union after the keys of this one.
+         */
+        void merge(const KeyUnion& other)
+        {
+            m_objects = m_objects and other.m_objects;
+            for (const auto& key : other.m_keys) {
+                insert(key);
+            }
+        }
+
+        bool objects() const noexcept { return m_objects; }
+
+        string_vector keys() const { return string_vector{ m_keys }; }
+
+    private:
+        void insert(std::string_view key)
+        {
+            if (auto [_, inserted] = m_set.emplace(key); inserted) {
+                m_keys.emplace_back(key);
+            }
+        }
+
+        std::vector<std::string>        m_keys;
+        std::unordered_set<std::string> m_set;
+        std::vector<std::string>        m_last;              // keys of the previous document
+        bool                            m_objects = true;    // whether all the documents are objects
+    };
+
+    /**
+     * @brief Get the top-level keys of a dom document.
+     *
+     * @param elem The document.
+     * @param keys Out parameter, reused between calls to avoid allocation.
+     *
+     * @return The keys, or `std::nullopt` if the document is not an object.
+     */
+    std::optional<std::span<const std::string_view>> object_keys(
+        simdjson::dom::element         elem,
+        std::vector<std::string_view>& keys
+    )
+    {
+        if (elem.type() != simdjson::dom::element_type::OBJECT) {
+            return std::nullopt;
+        }
+
+        keys.clear();
+        for (auto [key, _] : elem.get_object().value_unsafe()) {
+            keys.push_back(key);
+        }
+        return keys;
+    }
+
+    /**
+     * @brief Get the top-level keys of a document from its schema (see `object_keys`).
+     */
+    std::optional<std::span<const std::string_view>> object_keys(
+        const Schema&                  schema,
+        std::vector<std::string_view>& keys
+    )
+    {
+        if (not schema.root_is_object()) {
+            return std::nullopt;
+        }
+
+        using Part = Schema::Part;
+
+        keys.clear();
+        auto depth = 0;
+        for (auto part : schema) {
+            if (part == Part{ Schema::Object::Begin } or part == Part{ Schema::Array::Begin }) {
+                ++depth;
+            } else if (part == Part{ Schema::Object::End } or part == Part{ Schema::Array::End }) {
+                --depth;
+            } else if (auto* key = std::get_if<Schema::Key>(&part); key != nullptr and depth == 1) {
+                keys.push_back(key->m_key);
+            }
+        }
+        return keys;
+    }
+
+    /**
+     * @brief Merge the key unions pairwise in a tree, each level in parallel.
+     *
+     * @param unions The unions in the order of the documents they are built from.
+     * @param concurrency Number of threads.
+     */
+    KeyUnion reduce_unions(std::vector<KeyUnion> unions, std::size_t concurrency)
+    {
+        if (unions.empty()) {
+            return {};
+        }
+
+        for (auto step = 1ul; step < unions.size(); step *= 2) {
+            auto pairs = (unions.size() + 2 * step - 1) / (2 * step);
+            run_tasks(concurrency, pairs, [&](std::size_t, std::size_t pair) {
+                auto left  = pair * 2 * step;
+                auto right = left + step;
+                if (right < unions.size()) {
+                    unions[left].merge(unions[right]);
+                }
+            });
+        }
+
+        return std::move(unions.front());
+    }
+
+    /**
+     * @brief Turn a field of a struct array into a column (union mode, columnar layout).
+     *
+     * @param values The values of the field (a column), the missing ones are [].
+     *
+     * @return A column vector if every value is a real scalar number or missing (NaN), a logical column
+     *         vector if every value is a logical scalar, or the values as a cell otherwise.
+     */
+    octave_value make_union_column(const Cell& values)
+    {
+        auto numbers = true;
+        auto bools   = true;
+
+        for (auto i = 0l; i < values.numel() and (numbers or bools); ++i) {
+            const auto& value = values(i);
+
+            auto missing  = value.is_double_type() and value.isempty();
+            numbers      &= missing or (value.is_double_type() and value.is_real_scalar());
+            bools        &= value.is_bool_scalar();
+        }
+
+        auto dims = dim_vector{ values.numel(), 1 };
+
+        if (numbers) {
+            auto column = NDArray{ dims };
+            for (auto i = 0l; i < values.numel(); ++i) {
+                column(i) = values(i).isempty() ? octave_NaN : values(i).double_value();
+            }
+            return column;
+        } else if (bools) {
+            auto column = boolNDArray{ dims };
+            for (auto i = 0l; i < values.numel(); ++i) {
+                column(i) = values(i).bool_value();
+            }
+            return column;
+        }
+
+        return values;
+    }
+
+    /**
+     * @brief Create the result of union mode from the decoded documents.
+     *
+     * @param docs The decoded documents.
+     * @param keys The union of the keys of the documents.
+     * @param layout The layout of the result.
+     * @param concurrency Number of threads.
+     *
+     * @return A struct array (or a scalar struct of columns) with every key of the union, or `std::nullopt`
+     *         if not all documents are objects or none of them has a key.
+     */
+    std::optional<octave_value> make_union(
+        std::span<const octave_value> docs,
+        const KeyUnion&               keys,
+        Layout                        layout,
+        std::size_t                   concurrency
+    )
+    {
+        auto names = keys.keys();
+        if (docs.empty() or not keys.objects() or names.numel() == 0) {
+            return std::nullopt;
+        }
+
+        auto rows = make_struct_array(docs, names, concurrency, true);
+        if (layout == Layout::Rows) {
+            return rows;
+        }
+
+        auto columns = std::vector<octave_value>(static_cast<std::size_t>(names.numel()));
+        run_tasks(concurrency, columns.size(), [&](std::size_t, std::size_t i) {
+            columns[i] = make_union_column(rows.contents(static_cast<long>(i)));
+        });
+
+        auto map = octave_scalar_map{};
+        for (auto i = 0l; i < names.numel(); ++i) {
+            map.assign(names(i), columns[static_cast<std::size_t>(i)]);
+        }
+        return map;
+    }
+
+    /**
+     * @brief Create the result of the single-threaded load from the decoded documents.
+     *
+     * @param docs The decoded documents.
+     * @param objects Whether the documents are objects with the same keys.
+     *
+     * @return A struct array if the documents are objects with the same keys, cell array otherwise.
+     */
+    octave_value make_rows(const std::vector<octave_value>& docs, bool objects)
+    {
+        if (docs.empty()) {
+            return NDArray{};
+        }
+
+        if (docs.size() == 1) {
+            if (docs[0].isstruct()) {
+                return docs[0].scalar_map_value();
+            } else if (docs[0].isnumeric()) {
+                return docs[0].array_value();
+            } else {
+                return docs[0].cell_value();
+            }
+        }
+
+        if (objects) {
+            if (auto field_names = docs[0].scalar_map_value().fieldnames(); field_names.numel() != 0) {
+                return make_struct_array(docs, field_names, 1);
+            }
+        }
+
+        auto cell = Array<octave_value>{ dim_vector{ 1, static_cast<long>(docs.size()) } };
+        for (auto i = 0ul; i < docs.size(); ++i) {
+            cell(0, static_cast<long>(i)) = docs[i];
+        }
+        return cell;
+    }
+
+    /**
+     * @brief Error for a document whose schema doesn't match the reference schema.
+     *
+     * Only the schema of the document is kept, the message with the diff of both schemas is rendered later
+     * by `error_message` (on the calling thread, once the other threads have stopped).
+     */
+    struct SchemaMismatch : std::runtime_error
+    {
+        SchemaMismatch(const Schema& schema, std::size_t number)
+            : std::runtime_error{ "Mismatched schema, all documents must have the same schema" }
+            , m_schema{ schema }
+            , m_number{ number }
+        {
+        }
+
+        Schema      m_schema;
+        std::size_t m_number;
+    };
+
+    /**
+     * @brief Get the message of an error that happened while loading a document.
+     *
+     * @param e The error.
+     * @param reference The reference schema, if any.
+     * @param mode Parse mode.
+     *
+     * @return The message, with the diff of both schemas if the error is a `SchemaMismatch`.
+     *
+     * The first difference is always reported since it's found in a single pass. The full diff is skipped
+     * for large schemas, it's an LCS over every line of both schemas and would be unreadable anyway.
+     */
+    std::string error_message(const std::exception& e, const Schema* reference, ParseMode mode)
+    {
+        static constexpr auto max_diff_size = 16ul * 1024;    // in bytes of the schema
+
+        auto* mismatch = dynamic_cast<const SchemaMismatch*>(&e);
+        if (mismatch == nullptr or reference == nullptr) {
+            return e.what();
+        }
+
+        const auto& current       = mismatch->m_schema;
+        auto        dynamic_array = mode == ParseMode::DynamicArray;
+        auto        difference    = reference->first_difference(current, dynamic_array);
+
+        if (reference->size() > max_diff_size or current.size() > max_diff_size) {
+            return std::format(
+                "{}\n\nFirst difference (document number: {}): {}\n\n"
+                "(the schemas are too large to be shown in full)",
+                e.what(),
+                mismatch->m_number,
+                difference
+            );
+        }
+
+        auto [reference_diff, current_diff] = util::create_diff(
+            reference->stringify(dynamic_array), current.stringify(dynamic_array)
+        );
+        return std::format(
+            "{0:}\n\nFirst difference: {1:}"
+            "\n\nFirst document:\n{2:}\nCurrent document (document number: {4:}):\n{3:}",
+            e.what(),
+            difference,
+            reference_diff,
+            current_diff,
+            mismatch->m_number
+        );
+    }
+
+    /**
+     * @brief Single-threaded load using the On-Demand backend.
+     *
+     * Same as `load` but the documents are decoded while parsing, the schema of each document is built in
+     * the same pass. There is no decode plan nor columnar layout for this backend.
+     */
+    template <ParseMode Mode>
+    octave_value load_ondemand(simdjson::padded_string_view string, const Options& options)
+    {
+        auto& parser = thread_ondemand_parser();
+
+        auto maybe_stream = parser.iterate_many(string.data(), string.size(), options.m_batch_size);
+
         if (maybe_stream.error()) {
             error("failed to initilize simdjson: %s", simdjson::error_message(maybe_stream.error()));
         }
@@ -95,207 +830,855 @@ namespace octave_ndjson
         auto docs             = std::vector<octave_value>{};
         auto reference_schema = std::optional<Schema>{};
         auto schema           = Schema{ 0 };
+        auto projection       = options.m_fields ? &*options.m_fields : nullptr;
+        auto filter           = options.m_where ? &*options.m_where : nullptr;
+        auto key_union        = KeyUnion{};
+        auto keys             = std::vector<std::string_view>{};
+        auto progress         = std::optional<Progress>{};
+        auto seen             = 0ul;
+        auto stats            = options.m_stats;
+
+        if (options.m_progress) {
+            progress.emplace(string.size());
+        }
+        if (stats != nullptr) {
+            stats->resize(1);
+        }
+
+        auto counters = stats_counters(stats, 0);
+        auto scope    = Stats::Scope{ counters };
+        auto busy     = Stats::Timer{ Stats::current(&Stats::Counters::m_busy) };
+        auto parse    = Stats::Timer{ stats_wall(stats, Stats::Phase::Parse) };
+
+        for (auto it = stream.begin(); it != stream.end(); ++it) {
+            // detect interrupt
+            OCTAVE_QUIT;
+
+            if (++seen % Progress::stride == 0 and progress.has_value()) {
+                progress->update(it.current_index(), seen);
+                progress->report();
+            }
+
+            Arena::current().reset();
+
+            try {
+                auto doc = stream_document(*it, options.m_batch_size);
+                if (filter != nullptr and not filter->matches(doc)) {
+                    continue;
+                }
+
+                // union mode takes the keys from the schema
+                constexpr auto track = Mode != ParseMode::Relaxed;
+
+                // the document is parsed while being decoded, the parsing counts as decoding here
+                auto decode = Stats::Timer{ Stats::current(&Stats::Counters::m_decode) };
+                schema.reset();
+                auto value = parse_octave_value(doc, track ? &schema : nullptr, projection);
+                decode.stop();
+
+                auto compare = Stats::Timer{ Stats::current(&Stats::Counters::m_schema) };
+
+                if constexpr (Mode == ParseMode::Union) {
+                    key_union.add(object_keys(schema, keys));
+                } else if constexpr (checks_schema(Mode)) {
+                    if (not reference_schema.has_value()) {
+                        reference_schema = schema;
+                    } else if (not reference_schema->is_same(schema, Mode == ParseMode::DynamicArray)) {
+                        throw SchemaMismatch{ schema, docs.size() };
+                    }
+                }
+
+                docs.push_back(std::move(value));
+            } catch (std::exception& e) {
+                auto reference = reference_schema ? &*reference_schema : nullptr;
+                auto message   = error_message(e, reference, Mode);
+                if (progress.has_value()) {
+                    progress->finish();
+                }
+                offset_error(string, it.current_index(), message.c_str());
+            }
+        }
+
+        if (progress.has_value()) {
+            progress->update(string.size(), seen);
+            progress->finish();
+        }
+
+        busy.stop();
+        parse.stop();
+        if (counters != nullptr) {
+            counters->m_bytes     += string.size();
+            counters->m_documents += seen;
+        }
+
+        auto assemble = Stats::Timer{ stats_wall(stats, Stats::Phase::Assemble) };
+
+        if constexpr (Mode == ParseMode::Union) {
+            if (auto merged = make_union(docs, key_union, options.m_layout, 1)) {
+                return *merged;
+            }
+        }
+
+        auto has_ref = not docs.empty() and checks_schema(Mode);
+        auto objects = projection != nullptr or (has_ref and reference_schema->root_is_object());
+
+        return make_rows(docs, objects);
+    }
+
+    /**
+     * @brief Single-threaded load using the DOM backend (see `load`).
+     */
+    template <ParseMode Mode>
+    octave_value load_dom(simdjson::padded_string_view string, const Options& options)
+    {
+        auto& parser = thread_parser();
+
+        auto maybe_stream = parser.parse_many(string.data(), string.size(), options.m_batch_size);
+
+        if (maybe_stream.error()) {
+            error("failed to initilize simdjson: %s", simdjson::error_message(maybe_stream.error()));
+        }
+
+        auto stream           = std::move(maybe_stream).take_value();
+        auto docs             = std::vector<octave_value>{};
+        auto columnar         = std::optional<Columnar>{};
+        auto count            = 0ul;
+        auto reference_schema = std::optional<Schema>{};
+        auto schema           = Schema{ 0 };
+        auto plan             = std::optional<DecodePlan>{};
+        auto projection       = options.m_fields ? &*options.m_fields : nullptr;
+        auto fields           = std::vector<Projection::Field>{};
+        auto filter           = options.m_where ? &*options.m_where : nullptr;
+        auto key_union        = KeyUnion{};
+        auto keys             = std::vector<std::string_view>{};
+        auto progress         = std::optional<Progress>{};
+        auto seen             = 0ul;
+        auto stats            = options.m_stats;
+
+        if (options.m_progress) {
+            progress.emplace(string.size());
+        }
+        if (stats != nullptr) {
+            stats->resize(1);
+        }
+
+        // union mode decodes the documents as rows, the columns are made from the merged rows at the end
+        auto columnar_layout = options.m_layout == Layout::Columnar and Mode != ParseMode::Union;
+
+        auto counters = stats_counters(stats, 0);
+        auto scope    = Stats::Scope{ counters };
+        auto busy     = Stats::Timer{ Stats::current(&Stats::Counters::m_busy) };
+        auto parse    = Stats::Timer{ stats_wall(stats, Stats::Phase::Parse) };
 
         for (auto it = stream.begin(); it != stream.end(); ++it) {
             // detect interrupt
             OCTAVE_QUIT;
 
+            if (++seen % Progress::stride == 0 and progress.has_value()) {
+                progress->update(it.current_index(), seen);
+                progress->report();
+            }
+
+            Arena::current().reset();
+
             auto dom = *it;
             try {
-                auto parsed = parse_octave_value(dom.value());
-
-                if (mode == ParseMode::Relaxed) {
-                    docs.push_back(std::move(parsed));
+                auto elem = stream_document(dom, options.m_batch_size);
+                if (filter != nullptr and not filter->matches(elem)) {
                     continue;
                 }
 
-                schema.reset();
-                detail::build_schema(schema, dom.value());
+                if (projection != nullptr) {
+                    projection->select(elem, fields);
+                }
 
-                if (not reference_schema.has_value()) {
-                    reference_schema = schema;
+                // the number of documents is unknown beforehand, grow the columns geometrically
+                if (columnar_layout) {
+                    if (columnar.has_value()) {
+                        if (count >= columnar->rows()) {
+                            columnar->resize(columnar->rows() * 2);
+                        }
+                    } else if (projection != nullptr) {
+                        columnar.emplace(fields, 1024, options.m_numeric);
+                    } else {
+                        columnar.emplace(elem, 1024, options.m_numeric);
+                    }
                 }
 
-                if (not reference_schema->is_same(schema, mode == ParseMode::DynamicArray)) {
-                    auto [reference_diff, current_diff] = util::create_diff(
-                        reference_schema->stringify(mode == ParseMode::DynamicArray),
-                        schema.stringify(mode == ParseMode::DynamicArray)
-                    );
-                    auto message = std::format(
-                        "Mismatched schema, all documents must have the same schema"
-                        "\n\nFirst document:\n{0:}\nCurrent document (document number: {2:}):\n{1:}",
-                        reference_diff,
-                        current_diff,
-                        docs.size()
-                    );
+                // strict mode: decode and validate at the same time following the plan
+                if constexpr (Mode == ParseMode::Strict) {
+                    if (plan.has_value()) {
+                        auto decode = Stats::Timer{ Stats::current(&Stats::Counters::m_decode) };
+                        try {
+                            if (projection != nullptr and columnar.has_value()) {
+                                columnar->insert(count, fields, &*plan);
+                            } else if (projection != nullptr) {
+                                docs.push_back(decode_fields(*projection, fields, &*plan));
+                            } else if (columnar.has_value()) {
+                                columnar->insert(count, elem, &*plan);
+                            } else {
+                                docs.push_back(plan->decode(elem));
+                            }
+                        } catch (const DecodePlan::Mismatch&) {
+                            schema.reset();
+                            build_schema(schema, elem, fields, projection);
+                            throw SchemaMismatch{ schema, count };
+                        }
 
-                    throw std::runtime_error{ message };
+                        ++count;
+                        continue;
+                    }
                 }
 
-                docs.push_back(std::move(parsed));
-            } catch (std::exception& e) {
-                auto offset = it.current_index();
-                auto to_end = string.size() - static_cast<std::size_t>(offset);
-                auto substr = detail::escape_whitespace({ string.data() + offset, std::min(to_end, 50ul) });
+                if constexpr (Mode == ParseMode::Union) {
+                    key_union.add(object_keys(elem, keys));
+                } else if constexpr (Mode != ParseMode::Relaxed) {
+                    auto compare = Stats::Timer{ Stats::current(&Stats::Counters::m_schema) };
+
+                    schema.reset();
+                    build_schema(schema, elem, fields, projection);
+
+                    if (not reference_schema.has_value()) {
+                        reference_schema = schema;
+                        if constexpr (Mode == ParseMode::Strict) {
+                            plan.emplace(*reference_schema);
+                        }
+                    }
+
+                    if (not reference_schema->is_same(schema, Mode == ParseMode::DynamicArray)) {
+                        throw SchemaMismatch{ schema, count };
+                    }
+                }
 
-                auto message = std::format(
-                    "Parsing error\n"
-                    "\t> {}\n\n"
-                    "\t> around: [{}\033[1;33m{}\033[00m{}] (at offset: {})\n"
-                    "\t                ^\n"
-                    "\t                |\n"
-                    "\t  parsing ends here",
-                    e.what(),
-                    offset > 0 ? " ... " : "<bof>",
-                    substr,
-                    to_end > 50ul ? " ... " : "<eof>",
-                    offset
-                );
+                auto decode = Stats::Timer{ Stats::current(&Stats::Counters::m_decode) };
+
+                if (projection != nullptr and columnar.has_value()) {
+                    columnar->insert(count, fields);
+                } else if (projection != nullptr) {
+                    docs.push_back(decode_fields(*projection, fields, nullptr));
+                } else if (columnar.has_value()) {
+                    columnar->insert(count, elem);
+                } else {
+                    docs.push_back(parse_octave_value(elem));
+                }
 
-                error("%s", message.c_str());
+                ++count;
+            } catch (std::exception& e) {
+                auto reference = reference_schema ? &*reference_schema : nullptr;
+                auto message   = error_message(e, reference, Mode);
+                if (progress.has_value()) {
+                    progress->finish();
+                }
+                offset_error(string, it.current_index(), message.c_str());
             }
         }
 
-        if (docs.size() == 1) {
-            if (reference_schema->root_is_object()) {
-                return docs[0].scalar_map_value();
-            } else if (docs[0].isnumeric()) {
-                return docs[0].array_value();
-            } else {
-                return docs[0].cell_value();
-            }
+        if (progress.has_value()) {
+            progress->update(string.size(), seen);
+            progress->finish();
         }
 
-        if (mode != ParseMode::Relaxed and reference_schema->root_is_object()) {
-            auto struct_array      = octave_map{};
-            auto struct_array_dims = dim_vector{ static_cast<long>(docs.size()), 1 };
-            auto field_names       = docs[0].scalar_map_value().fieldnames();
+        busy.stop();
+        parse.stop();
+        if (counters != nullptr) {
+            counters->m_bytes     += string.size();
+            counters->m_documents += seen;
+        }
 
-            if (field_names.numel() != 0) {
-                auto value = Cell{ struct_array_dims };
-                for (auto i : sv::iota(0l, field_names.numel())) {
-                    for (auto k : sv::iota(0u, docs.size())) {
-                        value(k) = docs[k].scalar_map_value().getfield(field_names(i));
-                    }
-                    struct_array.assign(field_names(i), value);
-                }
-                return struct_array;
-            }
+        auto assemble = Stats::Timer{ stats_wall(stats, Stats::Phase::Assemble) };
+
+        if (columnar.has_value()) {
+            auto map = std::move(*columnar).release(count);
+            return projection ? projection->nest(map) : map;
         }
 
-        auto cell = Array<octave_value>{ dim_vector{ 1, static_cast<long>(docs.size()) } };
-        for (auto i = 0ul; i < docs.size(); ++i) {
-            cell(0, static_cast<long>(i)) = docs[i];
+        if constexpr (Mode == ParseMode::Union) {
+            if (auto merged = make_union(docs, key_union, options.m_layout, 1)) {
+                return *merged;
+            }
         }
-        return cell;
+
+        // the selected fields always form an object with the same keys
+        auto has_ref = count != 0 and checks_schema(Mode);
+        auto objects = projection != nullptr or (has_ref and reference_schema->root_is_object());
+
+        return make_rows(docs, objects);
     }
 
-    octave_value load_multi(simdjson::padded_string_view string, ParseMode mode)
+    /**
+     * @brief Multi-threaded load (see `load_multi`).
+     */
+    template <ParseMode Mode>
+    octave_value load_multi(simdjson::padded_string_view string, const Options& options, Reference& reference)
     {
-        auto lines = util::split(string, '\n');
+        static constexpr auto no_exception = std::numeric_limits<std::size_t>::max();
 
-        if (lines.size() == 0) {
-            return NDArray{};
-        } else if (lines.size() == 1) {
-            return load(string, mode);
+        auto concurrency = octave_ndjson::concurrency(options);
+        auto stats       = options.m_stats;
+
+        if (stats != nullptr) {
+            stats->resize(concurrency);
         }
 
-        static constexpr auto no_exception = std::numeric_limits<std::size_t>::max();
+        auto split_fn = [&](std::string_view window, std::size_t first_row) {
+            auto timer = Stats::Timer{ stats_wall(stats, Stats::Phase::Split) };
+            return split_lines(window, first_row, concurrency);
+        };
 
-        auto first_line = lines[0];
-        auto rem_lines  = std::span{ lines.begin() + 1, lines.size() - 1 };
+        // the input is processed in windows, while a window is parsed the lines of the next one are counted
+        // and the one after it is read ahead from the disk, so the I/O of a file that is not in the page
+        // cache yet and the splitting overlap with the parsing instead of happening before it. the windows
+        // are large enough that the threads waiting for each other at the end of a window is negligible.
+        static constexpr auto window_size = 256ul * 1024 * 1024;
 
-        // NOTE: too high number of concurrency leads to slower parsing time. I cannot know for sure what
-        // causes this, but I highly suspect that this caused by memory contention of some sort. This
-        // bottleneck issue is not a trivial one and from my testing, halving the number of threads works
-        // best, though letting the user control the number of threads at runtime may be better.
+        auto windows = util::split_chunks(string, std::max(string.size() / window_size, 1ul), '\n');
+        auto window  = 0ul;
+
+        if (windows.size() > 1) {
+            prefetch(windows[1]);
+        }
+
+        // a window may only contain empty lines
+        auto split = split_fn(windows.empty() ? "" : windows[0], 0);
+        while (split.m_offsets.back() == 0 and window + 1 < windows.size()) {
+            split = split_fn(windows[++window], 0);
+        }
+
+        auto num_lines = split.m_offsets.back();
 
-        auto concurrency = std::max(std::thread::hardware_concurrency() / 2, 1u);
-        concurrency      = std::min(concurrency, static_cast<unsigned int>(rem_lines.size()));
+        if (num_lines == 0) {
+            return NDArray{};
+        }
+
+        // the output is allocated from an estimate extrapolated from the first window, grown when the
+        // estimate is exceeded and trimmed at the end
+        auto read      = static_cast<double>(windows[window].end() - string.begin());
+        auto ratio     = static_cast<double>(string.size()) / read;
+        auto estimate  = static_cast<std::size_t>(ratio * static_cast<double>(num_lines));
+
+        // union mode decodes the documents as rows, the columns are made from the merged rows at the end.
+        // the keys are collected for each chunk then reduced, so the order of first occurrence is kept.
+        constexpr auto merge = Mode == ParseMode::Union;
 
-        auto block_size = rem_lines.size() / concurrency;
-        auto parsers    = std::vector<simdjson::dom::parser>(concurrency);
-        auto threads    = std::vector<std::jthread>{};
+        auto columnar_layout = options.m_layout == Layout::Columnar and not merge;
+        auto unions          = std::vector<KeyUnion>(merge ? 1 : 0);    // the first is for the reference
+        auto union_base      = 0ul;
 
-        auto cell            = Cell{ dim_vector(static_cast<long>(lines.size()), 1) };
+        auto cell_rows = columnar_layout ? 0l : static_cast<long>(estimate);
+
+        auto cell            = Cell{ dim_vector(cell_rows, 1) };
         auto exception       = std::exception_ptr{};
         auto exception_index = std::atomic<std::size_t>{ no_exception };
+        auto exception_line  = std::string_view{};
+        auto stop            = std::atomic<bool>{ false };
+        auto count           = num_lines;    // number of rows of the result
+        auto reference_row   = no_exception;    // the first kept row, unknown until found
+
+        auto& reference_schema = reference.m_schema;
+        auto& plan             = reference.m_plan;
+        auto  columnar         = std::optional<Columnar>{};
+        auto  projection       = options.m_fields ? &*options.m_fields : nullptr;
+        auto  filter           = options.m_where ? &*options.m_where : nullptr;
 
-        auto reference_schema = Schema{ 0 };
+        // whether each row matches the filter, the rows that don't are dropped at the end
+        auto kept = std::vector<char>(filter != nullptr ? num_lines : 0);
+
+        auto progress = std::optional<Progress>{};
+        if (options.m_progress) {
+            progress.emplace(string.size());
+        }
 
-        auto parse_fn = [&](simdjson::dom::parser& parser, std::span<std::string_view> block, long offset) {
-            auto schema = Schema{ 0 };
+        // the main thread checks for interrupts and prints the progress while the workers parse, an
+        // interrupt stops the workers at the next line (or array) before being rethrown
+        auto poll_fn = [&] {
+            if (progress.has_value()) {
+                progress->report();
+            }
 
-            for (auto [i, line] : block | sv::enumerate) {
-                // detect interrupt
+            try {
                 OCTAVE_QUIT;
+            } catch (...) {
+                stop = true;
+                throw;
+            }
+        };
 
-                if (exception_index != no_exception) {
-                    break;
+        // decode a line and validate it against the reference
+        auto decode_fn = [&](Schema& schema, auto& fields, std::size_t row, simdjson::dom::element dom) {
+            auto plan_p = plan ? &*plan : nullptr;
+            auto index  = static_cast<long>(row);
+            auto number = reference.m_lines + row + 1;    // line numbering is 1-indexed
+
+            if (projection != nullptr) {
+                projection->select(dom, fields);
+            }
+
+            // strict mode: decode and validate at the same time following the plan
+            if constexpr (Mode == ParseMode::Strict) {
+                if (plan_p != nullptr) {
+                    auto decode = Stats::Timer{ Stats::current(&Stats::Counters::m_decode) };
+                    try {
+                        if (projection != nullptr and columnar.has_value()) {
+                            columnar->insert(row, fields, plan_p);
+                        } else if (projection != nullptr) {
+                            cell(index) = decode_fields(*projection, fields, plan_p);
+                        } else if (columnar.has_value()) {
+                            columnar->insert(row, dom, plan_p);
+                        } else {
+                            cell(index) = plan_p->decode(dom);
+                        }
+                    } catch (const DecodePlan::Mismatch&) {
+                        schema.reset();
+                        build_schema(schema, dom, fields, projection);
+                        throw SchemaMismatch{ schema, number };
+                    }
+                    return;
+                }
+            }
+
+            if constexpr (checks_schema(Mode)) {
+                auto compare = Stats::Timer{ Stats::current(&Stats::Counters::m_schema) };
+
+                schema.reset();
+                build_schema(schema, dom, fields, projection);
+
+                if (not reference_schema.is_same(schema, Mode == ParseMode::DynamicArray)) {
+                    throw SchemaMismatch{ schema, number };
+                }
+            }
+
+            auto decode = Stats::Timer{ Stats::current(&Stats::Counters::m_decode) };
+
+            if (projection != nullptr and columnar.has_value()) {
+                columnar->insert(row, fields);
+            } else if (projection != nullptr) {
+                cell(index) = decode_fields(*projection, fields, nullptr);
+            } else if (columnar.has_value()) {
+                columnar->insert(row, dom);
+            } else {
+                cell(index) = parse_octave_value(dom);
+            }
+        };
+
+        // decode a line using the On-Demand backend, the schema is built while decoding. returns whether the
+        // line matches the filter.
+        auto decode_ondemand_fn = [&](Schema& schema, std::size_t row, std::string_view line) {
+            auto& parser    = thread_ondemand_parser();
+            auto  allocated = string.capacity() - static_cast<std::size_t>(line.data() - string.data());
+            auto  doc       = parser.iterate(line.data(), line.size(), allocated).value();
+            auto  track     = Mode != ParseMode::Relaxed;    // union mode takes the keys from the schema
+            auto  number    = reference.m_lines + row + 1;    // line numbering is 1-indexed
+            auto  matched   = filter == nullptr or filter->matches(doc);
+
+            if (not matched) {
+                return false;
+            }
+
+            // the document is parsed while being decoded, the parsing counts as decoding here
+            auto decode = Stats::Timer{ Stats::current(&Stats::Counters::m_decode) };
+            schema.reset();
+            auto value = parse_octave_value(doc, track ? &schema : nullptr, projection);
+            decode.stop();
+
+            // the fields that are not selected are skipped, so the document may not be at the end
+            if (projection == nullptr and not doc.at_end()) {
+                throw simdjson::simdjson_error{ simdjson::TRAILING_CONTENT };
+            }
+
+            if (checks_schema(Mode) and reference.m_initialized) {
+                auto compare = Stats::Timer{ Stats::current(&Stats::Counters::m_schema) };
+                if (not reference_schema.is_same(schema, Mode == ParseMode::DynamicArray)) {
+                    throw SchemaMismatch{ schema, number };
+                }
+            }
+
+            cell(static_cast<long>(row)) = std::move(value);
+            return matched;
+        };
+
+        // keep the first error, the other threads may be cancelled in turn
+        auto fail_fn = [&](std::size_t row, std::string_view line) {
+            if (auto i = no_exception; exception_index.compare_exchange_strong(i, row)) {
+                exception      = std::current_exception();
+                exception_line = line;
+                stop           = true;
+            }
+        };
+
+        // parse a chunk line by line using the On-Demand backend
+        auto parse_ondemand_fn = [&](std::size_t thread, std::size_t chunk) {
+            auto& arena    = Arena::current();
+            auto& scratch  = thread_scratch();
+            auto  splitter = util::StringSplitter{ split.m_chunks[chunk], '\n' };
+            auto  scope    = CancelScope{ stop };
+            auto  counters = stats_counters(stats, thread);
+            auto  counted  = Stats::Scope{ counters };
+            auto  busy     = Stats::Timer{ Stats::current(&Stats::Counters::m_busy) };
+
+            for (auto row = split.m_offsets[chunk]; auto line = splitter.next(); ++row) {
+                // an error on another thread or an interrupt, only the main thread checks for the latter
+                if (stop.load(std::memory_order_relaxed)) {
+                    return;
+                }
+
+                // the rows up to the reference are already parsed
+                if (row <= reference_row) {
+                    continue;
                 }
 
+                arena.reset();
+
                 try {
-                    auto dom             = parser.parse(line.data(), line.size(), false).value();
-                    cell(offset + i + 1) = parse_octave_value(dom);    // 1st line is skipped
+                    auto matched = decode_ondemand_fn(scratch.m_schema, row, *line);
+                    if (filter != nullptr) {
+                        kept[row] = matched;
+                    }
+                    if (merge and matched) {
+                        unions[union_base + chunk].add(object_keys(scratch.m_schema, scratch.m_keys));
+                    }
+                } catch (...) {
+                    fail_fn(row, *line);
+                }
+            }
 
-                    if (mode == ParseMode::Relaxed) {
+            auto lines = split.m_offsets[chunk + 1] - split.m_offsets[chunk];
+            if (progress.has_value()) {
+                progress->add(split.m_chunks[chunk].size(), lines);
+            }
+            if (counters != nullptr) {
+                counters->m_bytes     += split.m_chunks[chunk].size();
+                counters->m_documents += lines;
+            }
+        };
+
+        // parse a chunk as a document stream using the DOM backend, so the structural indexing runs over a
+        // whole batch at once instead of a single line. the documents are numbered in order, so there must
+        // be exactly one document per line for the rows of the chunks not to overlap.
+        auto parse_dom_fn = [&](std::size_t thread, std::size_t chunk) {
+            auto& parser   = thread_parser();
+            auto& arena    = Arena::current();
+            auto& scratch  = thread_scratch();
+            auto  lines    = split.m_chunks[chunk];
+            auto  first    = split.m_offsets[chunk];
+            auto  last     = split.m_offsets[chunk + 1];
+            auto  row      = first;
+            auto  offset   = 0ul;    // offset of the current document in the chunk
+            auto  scope    = CancelScope{ stop };
+            auto  counters = stats_counters(stats, thread);
+            auto  counted  = Stats::Scope{ counters };
+            auto  busy     = Stats::Timer{ Stats::current(&Stats::Counters::m_busy) };
+
+            // a chunk larger than the batch size is parsed as a single batch, so a line of any size fits,
+            // same as when each line was parsed on its own. the chunks are small unless their lines are long.
+            auto batch_size = std::max(options.m_batch_size, lines.size());
+
+#ifdef SIMDJSON_THREADS_ENABLED
+            // the chunks are already parsed in parallel, no need for a stage 1 thread for each of them
+            parser.threaded = false;
+#endif
+
+            try {
+                auto maybe_stream = parser.parse_many(lines.data(), lines.size(), batch_size);
+                if (maybe_stream.error()) {
+                    throw simdjson::simdjson_error{ maybe_stream.error() };
+                }
+
+                auto stream = std::move(maybe_stream).take_value();
+                for (auto it = stream.begin(); it != stream.end(); ++it, ++row) {
+                    // an error on another thread or an interrupt, only the main thread checks for the latter
+                    if (stop.load(std::memory_order_relaxed)) {
+                        return;
+                    }
+
+                    offset = it.current_index();
+                    if (row == last) {
+                        throw std::runtime_error{ "Expected one document per line, found more documents" };
+                    }
+
+                    // the rows up to the reference are already parsed
+                    if (row <= reference_row) {
                         continue;
                     }
 
-                    schema.reset();
-                    detail::build_schema(schema, dom);
-
-                    if (not reference_schema.is_same(schema, mode == ParseMode::DynamicArray)) {
-                        auto [reference_diff, current_diff] = util::create_diff(
-                            reference_schema.stringify(mode == ParseMode::DynamicArray),
-                            schema.stringify(mode == ParseMode::DynamicArray)
-                        );
-                        throw std::runtime_error{ std::format(
-                            "Mismatched schema, all documents must have the same schema"
-                            "\n\nFirst document:\n{0:}\nCurrent document (document number: {2:}):\n{1:}",
-                            reference_diff,
-                            current_diff,
-                            offset + i + 2    // line numbering is 1-indexed; 1st line is skipped
-                        ) };
+                    arena.reset();
+
+                    auto dom = stream_document(*it, batch_size);
+                    if (filter != nullptr) {
+                        kept[row] = filter->matches(dom);
+                        if (not kept[row]) {
+                            continue;
+                        }
                     }
-                } catch (...) {
-                    auto idx = static_cast<std::size_t>(offset + i) + 1;    // 1st line is skipped
-                    if (auto i = no_exception; exception_index.compare_exchange_strong(i, idx)) {
-                        exception = std::current_exception();
+
+                    decode_fn(scratch.m_schema, scratch.m_fields, row, dom);
+                    if (merge) {
+                        unions[union_base + chunk].add(object_keys(dom, scratch.m_keys));
                     }
                 }
+
+                // fewer documents than lines, reported at the line after the last document
+                if (row != last) {
+                    offset = row != first ? lines.find('\n', offset) + 1 : 0;
+                    throw std::runtime_error{
+                        "Expected one document per line, found a blank line, an incomplete document, or a "
+                        "document spanning several lines"
+                    };
+                }
+
+                if (progress.has_value()) {
+                    progress->add(lines.size(), last - first);
+                }
+                if (counters != nullptr) {
+                    counters->m_bytes     += lines.size();
+                    counters->m_documents += last - first;
+                }
+            } catch (...) {
+                fail_fn(row, line_at(lines, offset));
             }
         };
 
-        try {
-            // the first line is parsed separately here to get the reference schema
-            auto dom = parsers[0].parse(first_line.data(), first_line.size(), false);
-            if (dom.error()) {
-                exception_index = 0;
+        // find the first row of a chunk that matches the filter, the rows before it are only parsed. the
+        // chunks are taken in order, so the chunks after the one with the match stop at their first row.
+        auto first_kept = std::atomic<std::size_t>{ no_exception };
+        auto search_fn  = [&](std::size_t, std::size_t chunk) {
+            auto splitter = util::StringSplitter{ split.m_chunks[chunk], '\n' };
+
+            for (auto row = split.m_offsets[chunk]; auto line = splitter.next(); ++row) {
+                auto found = first_kept.load(std::memory_order_relaxed);
+                if (stop.load(std::memory_order_relaxed) or row > found) {
+                    return;
+                }
+
+                try {
+                    auto matched = false;
+                    if (options.m_backend == Backend::OnDemand) {
+                        auto& parser    = thread_ondemand_parser();
+                        auto  offset    = static_cast<std::size_t>(line->data() - string.data());
+                        auto  allocated = string.capacity() - offset;
+                        auto  doc       = parser.iterate(line->data(), line->size(), allocated).value();
+                        matched         = filter->matches(doc);
+                    } else if (auto dom = thread_parser().parse(line->data(), line->size(), false);
+                               dom.error()) {
+                        throw simdjson::simdjson_error{ dom.error() };
+                    } else {
+                        matched = filter->matches(dom.value());
+                    }
+
+                    // keep the smallest row, another chunk may have found an earlier one meanwhile
+                    if (matched) {
+                        while (row < found and not first_kept.compare_exchange_weak(found, row)) { }
+                        return;
+                    }
+                } catch (...) {
+                    fail_fn(row, *line);
+                    return;
+                }
+            }
+        };
+
+        // decode the reference row on this thread, the schema, the plan, and the columns are taken from it
+        auto decode_reference_fn = [&](std::size_t row, std::string_view line) {
+            exception_index = row;
+            exception_line  = line;
+
+            // the main thread uses the counters of the first worker, they don't run at the same time
+            auto counted = Stats::Scope{ stats_counters(stats, 0) };
+            auto busy    = Stats::Timer{ Stats::current(&Stats::Counters::m_busy) };
+            auto rows    = std::max(estimate, num_lines);
+
+            Arena::current().reset();
+
+            if (options.m_backend == Backend::OnDemand) {
+                auto schema = Schema{ 0 };
+                auto keys   = std::vector<std::string_view>{};
+                decode_ondemand_fn(schema, row, line);
+
+                if (filter != nullptr) {
+                    kept[row] = true;
+                }
+                if (merge) {
+                    unions.front().add(object_keys(schema, keys));
+                }
+
+                if (not reference.m_initialized) {
+                    reference_schema        = std::move(schema);
+                    reference.m_initialized = true;
+                }
+            } else if (auto dom = thread_parser().parse(line.data(), line.size(), false); dom.error()) {
                 throw simdjson::simdjson_error{ dom.error() };
             } else {
-                cell(0) = parse_octave_value(dom.value());
-                if (mode != ParseMode::Relaxed) {
-                    detail::build_schema(reference_schema, dom.value());
-                };
+                auto elem   = dom.value();
+                auto fields = std::vector<Projection::Field>{};
+                if (projection != nullptr) {
+                    projection->select(elem, fields);
+                }
+
+                if (columnar_layout and projection != nullptr) {
+                    columnar.emplace(fields, rows, options.m_numeric);
+                } else if (columnar_layout) {
+                    columnar.emplace(elem, rows, options.m_numeric);
+                }
+
+                if (not reference.m_initialized) {
+                    if constexpr (checks_schema(Mode)) {
+                        build_schema(reference_schema, elem, fields, projection);
+                    }
+                    if constexpr (Mode == ParseMode::Strict) {
+                        plan.emplace(reference_schema);
+                    }
+                    reference.m_initialized = true;
+                }
+
+                auto schema = Schema{ 0 };
+                decode_fn(schema, fields, row, elem);
+
+                if (filter != nullptr) {
+                    kept[row] = true;
+                }
+                if (merge) {
+                    auto keys = std::vector<std::string_view>{};
+                    unions.front().add(object_keys(elem, keys));
+                }
+            }
+
+            exception_index = no_exception;
+        };
+
+        // the chunks of the next window, their lines are counted by the tasks of the first run on the current
+        // window after its own chunks, so the threads that are done early count them while the others parse
+        auto next        = LineChunks{};
+        auto next_chunks = 0ul;    // chunks of `next` not counted yet
+
+        auto run_window_fn = [&](auto& fn) {
+            auto chunks   = split.m_chunks.size();
+            auto counting = std::exchange(next_chunks, 0ul);
+
+            auto task_fn = [&](std::size_t thread, std::size_t task) {
+                if (task < chunks) {
+                    fn(thread, task);
+                } else {
+                    count_lines(next, task - chunks);
+                }
+            };
+            run_tasks(concurrency, chunks + counting, task_fn, poll_fn);
+        };
+
+        // the reference is the first row kept, so the rows that are filtered out don't need to follow it and
+        // the result is the same as the single-threaded load. returns whether it's in the current window.
+        auto find_reference_fn = [&] {
+            if (filter == nullptr) {
+                first_kept = split.m_offsets.front();
+            } else {
+                run_window_fn(search_fn);
+                if (exception_index != no_exception) {
+                    std::rethrow_exception(exception);
+                } else if (first_kept == no_exception) {
+                    if (progress.has_value()) {
+                        auto lines = split.m_offsets.back() - split.m_offsets.front();
+                        progress->add(windows[window].size(), lines);
+                    }
+                    return false;
+                }
+            }
+
+            reference_row = first_kept;
+
+            // the chunk whose rows contain the reference row
+            auto upper    = std::ranges::upper_bound(split.m_offsets, reference_row);
+            auto chunk    = static_cast<std::size_t>(upper - split.m_offsets.begin()) - 1;
+            auto splitter = util::StringSplitter{ split.m_chunks[chunk], '\n' };
+            for (auto row = split.m_offsets[chunk]; row < reference_row; ++row) {
+                splitter.next();
+            }
+
+            decode_reference_fn(reference_row, splitter.next().value());
+            return true;
+        };
+
+        try {
+            // the input is parsed here, one window at a time
+            while (true) {
+                if (window + 1 < windows.size()) {
+                    auto timer  = Stats::Timer{ stats_wall(stats, Stats::Phase::Split) };
+                    next        = cut_lines(windows[window + 1], concurrency);
+                    next_chunks = next.m_chunks.size();
+                }
+                if (window + 2 < windows.size()) {
+                    prefetch(windows[window + 2]);
+                }
+
+                auto parsing = Stats::Timer{ stats_wall(stats, Stats::Phase::Parse) };
+
+                // a window without a kept row is done once it's searched
+                if (reference_row != no_exception or find_reference_fn()) {
+                    if (merge) {
+                        union_base = unions.size();
+                        unions.resize(union_base + split.m_chunks.size());
+                    }
+
+                    if (options.m_backend == Backend::OnDemand) {
+                        run_window_fn(parse_ondemand_fn);
+                    } else {
+                        run_window_fn(parse_dom_fn);
+                    }
+                }
+                parsing.stop();
+
+                if (exception_index != no_exception) {
+                    std::rethrow_exception(exception);
+                } else if (++window == windows.size()) {
+                    break;
+                }
+
+                // the lines were counted with the tasks of the window that was just parsed or searched
+                if (next_chunks != 0) {
+                    split = split_fn(windows[window], num_lines);
+                } else {
+                    auto timer = Stats::Timer{ stats_wall(stats, Stats::Phase::Split) };
+                    split      = std::move(next);
+                    number_lines(split, num_lines);
+                }
+                num_lines = split.m_offsets.back();
+
+                if (filter != nullptr) {
+                    kept.resize(num_lines);
+                }
+
+                // geometric growth, so a bad estimate doesn't make the output copied on every window
+                if (auto rows = columnar ? columnar->rows() : static_cast<std::size_t>(cell.numel());
+                    num_lines > rows) {
+                    auto grown = std::max(num_lines, rows * 2);
+                    if (columnar.has_value()) {
+                        columnar->resize(grown);
+                    } else {
+                        cell.resize(dim_vector(static_cast<long>(grown), 1));
+                    }
+                }
             }
 
-            // the rest is parsed here
-            for (auto i : sv::iota(0u, concurrency)) {
-                auto offset       = i * block_size;    // first line is already parsed
-                auto current_size = std::min(block_size, rem_lines.size() - offset);
-                auto block        = std::span{ rem_lines.begin() + static_cast<long>(offset), current_size };
-                threads.emplace_back(parse_fn, std::ref(parsers[i]), block, offset);
+            if (cell.numel() > static_cast<long>(num_lines)) {
+                cell.resize(dim_vector(static_cast<long>(num_lines), 1));
             }
-            for (auto& thread : threads) {
-                thread.join();
+
+            count = filter != nullptr ? keep_rows(kept, cell, columnar) : num_lines;
+
+            if (progress.has_value()) {
+                progress->finish();
             }
-            if (exception_index != no_exception) {
-                std::rethrow_exception(exception);
+        } catch (const octave::interrupt_exception&) {
+            if (progress.has_value()) {
+                progress->finish();
             }
+            throw;
         } catch (std::exception& e) {
-            auto line   = lines[exception_index];
-            auto substr = detail::escape_whitespace(line.substr(0, std::min(line.size(), 50ul)));
+            if (progress.has_value()) {
+                progress->finish();
+            }
+
+            auto line   = exception_line;
+            auto substr = escape_whitespace(line.substr(0, std::min(line.size(), 50ul)));
+            auto schema = reference.m_initialized ? &reference_schema : nullptr;
+            auto what   = error_message(e, schema, Mode);
 
             auto message = std::format(
                 "Parsing error\n"
@@ -304,17 +1687,38 @@ namespace octave_ndjson
                 "\t                ^\n"
                 "\t                |\n"
                 "\t  parsing ends here",
-                e.what(),
+                what,
                 substr,
                 line.size() > 50ul ? " ... " : "<eol>",
-                exception_index + 1    // line numbering is 1-indexed
+                reference.m_lines + exception_index + 1    // line numbering is 1-indexed
             );
 
             error("%s", message.c_str());
         }
 
+        reference.m_lines += num_lines;
+
+        auto assemble = Stats::Timer{ stats_wall(stats, Stats::Phase::Assemble) };
+
+        if (count == 0) {
+            return NDArray{};
+        }
+
+        if (merge) {
+            auto keys = reduce_unions(std::move(unions), concurrency);
+            auto docs = std::span{ cell.data(), static_cast<std::size_t>(cell.numel()) };
+            if (auto merged = make_union(docs, keys, options.m_layout, concurrency)) {
+                return *merged;
+            }
+        }
+
+        if (columnar.has_value()) {
+            auto map = std::move(*columnar).release(count);
+            return projection ? projection->nest(map) : map;
+        }
+
         if (cell.numel() == 1) {
-            if (reference_schema.root_is_object()) {
+            if (cell(0).isstruct()) {
                 return cell(0).scalar_map_value();
             } else if (cell(0).isnumeric()) {
                 return cell(0).array_value();
@@ -323,23 +1727,75 @@ namespace octave_ndjson
             }
         }
 
-        if (mode != ParseMode::Relaxed and reference_schema.root_is_object()) {
-            auto struct_array      = octave_map{};
-            auto struct_array_dims = dim_vector{ cell.numel(), 1 };
-            auto field_names       = cell(0).scalar_map_value().fieldnames();
-
-            if (field_names.numel() != 0) {
-                auto value = Cell{ struct_array_dims };
-                for (auto i : sv::iota(0l, field_names.numel())) {
-                    for (auto k : sv::iota(0l, cell.numel())) {
-                        value(k) = cell(k).scalar_map_value().getfield(field_names(i));
-                    }
-                    struct_array.assign(field_names(i), value);
-                }
-                return struct_array;
+        // the selected fields always form an object with the same keys
+        if (projection != nullptr or (checks_schema(Mode) and reference_schema.root_is_object())) {
+            if (auto field_names = cell(0).scalar_map_value().fieldnames(); field_names.numel() != 0) {
+                auto docs = std::span{ cell.data(), static_cast<std::size_t>(cell.numel()) };
+                return make_struct_array(docs, field_names, concurrency);
             }
         }
 
         return cell;
     }
+
+    /**
+     * @brief Call a loader instantiated for a parse mode.
+     *
+     * @param fn Called with the mode as a `std::integral_constant`, so the checks of the mode on each
+     *           document are resolved at compile time and the loop of each mode only has its own code.
+     */
+    template <typename Fn>
+    octave_value with_mode(ParseMode mode, Fn&& fn)
+    {
+        using M = ParseMode;
+
+        switch (mode) {
+        case M::Strict: return fn(std::integral_constant<M, M::Strict>{});
+        case M::DynamicArray: return fn(std::integral_constant<M, M::DynamicArray>{});
+        case M::Relaxed: return fn(std::integral_constant<M, M::Relaxed>{});
+        case M::Union: return fn(std::integral_constant<M, M::Union>{});
+        default: [[unlikely]] std::abort();
+        }
+    }
+}
+
+namespace octave_ndjson
+{
+    std::size_t concurrency(const Options& options)
+    {
+        return concurrency(options.m_threads);
+    }
+
+    std::size_t concurrency(std::size_t threads)
+    {
+        // NOTE: too high number of concurrency leads to slower parsing time. I cannot know for sure what
+        // causes this, but I highly suspect that this caused by memory contention of some sort. This
+        // bottleneck issue is not a trivial one and from my testing, halving the number of threads works
+        // best. The user can override it though.
+
+        return threads != 0 ? threads : std::max(std::thread::hardware_concurrency() / 2, 1u);
+    }
+
+    octave_value load(simdjson::padded_string_view string, const Options& options)
+    {
+        return detail::with_mode(options.m_mode, [&](auto mode) {
+            if (options.m_backend == Backend::OnDemand) {
+                return detail::load_ondemand<decltype(mode)::value>(string, options);
+            }
+            return detail::load_dom<decltype(mode)::value>(string, options);
+        });
+    }
+
+    octave_value load_multi(simdjson::padded_string_view string, const Options& options)
+    {
+        auto reference = Reference{};
+        return load_multi(string, options, reference);
+    }
+
+    octave_value load_multi(simdjson::padded_string_view string, const Options& options, Reference& reference)
+    {
+        return detail::with_mode(options.m_mode, [&](auto mode) {
+            return detail::load_multi<decltype(mode)::value>(string, options, reference);
+        });
+    }
 }
@@ -1,7 +1,16 @@
 #pragma once
 
+#include "decode_plan.hpp"
+#include "filter.hpp"
+#include "projection.hpp"
+#include "schema.hpp"
+#include "stats.hpp"
+
 #include <simdjson/padded_string_view.h>
 
+#include <cstddef>
+#include <optional>
+
 class octave_value;
 
 namespace octave_ndjson
@@ -16,35 +25,137 @@ namespace octave_ndjson
 
         // Documents can have different schemas
         Relaxed,
+
+        // Documents can have different schemas, object documents are merged into a struct array with the
+        // union of their top-level keys (the missing fields are filled with [] or NaN)
+        Union,
+    };
+
+    enum class Layout
+    {
+        // Documents are returned as struct array (or cell array if the schema differs)
+        Rows,
+
+        // Documents are returned as a scalar struct with each top-level key as a column
+        Columnar,
+    };
+
+    enum class Backend
+    {
+        // Parse each document into a dom tree first, then decode the tree
+        Dom,
+
+        // Decode each document directly while parsing it using the simdjson On-Demand API (rows layout only)
+        OnDemand,
+    };
+
+    enum class Numeric
+    {
+        // Numbers are stored as double
+        Double,
+
+        // Integers are stored as int64 (or uint64 if they don't fit), a column with a non-integer is double
+        Preserve,
+
+        // Numbers are stored as single
+        Single,
+
+        // Numbers are stored as the narrowest type that represents every number of a column exactly
+        Auto,
+    };
+
+    struct Options
+    {
+        ParseMode   m_mode;
+        Layout      m_layout;
+        Backend     m_backend;
+        Numeric     m_numeric;       // storage of the numeric columns (columnar layout only)
+        std::size_t m_threads;       // number of threads for multithreaded load, 0 means default
+        std::size_t m_batch_size;    // batch size of the document streams in bytes, at least the largest line
+        bool        m_progress;      // print the throughput while loading
+        Stats*      m_stats;         // collect the timings and the counters if set
+
+        std::optional<Projection> m_fields;    // decode only the selected fields if set
+        std::optional<Filter>     m_where;     // keep only the documents that match if set
     };
 
+    /**
+     * @brief The reference the documents are checked against, carried over between consecutive loads.
+     *
+     * Used when the input is loaded in batches (e.g. streaming a file), so every batch is checked against
+     * the first document of the first batch and the line numbering continues from the previous batch.
+     */
+    struct Reference
+    {
+        bool                      m_initialized = false;
+        Schema                    m_schema      = Schema{ 0 };
+        std::optional<DecodePlan> m_plan        = std::nullopt;    // strict mode only
+        std::size_t               m_lines       = 0;               // number of lines already loaded
+    };
+
+    /**
+     * @brief Get the number of workers used by the multi-threaded functions.
+     *
+     * @param options Parse options, `m_threads` overrides the default if set.
+     */
+    std::size_t concurrency(const Options& options);
+
+    /**
+     * @brief Get the number of workers used by the multi-threaded functions.
+     *
+     * @param threads Overrides the default if not 0.
+     */
+    std::size_t concurrency(std::size_t threads);
+
     /**
      * @brief Load and parse a JSON string into an Octave value (single-threaded).
      *
      * @param string The input string.
-     * @param mode Parse mode.
+     * @param options Parse options.
      *
      * @return The Octave value.
      *
      * @throw <internal_octave_error> if there is an error parsing the JSON string.
      *
      * I believe the `error` function provided by octave throws an exception, but I have no idea what
-     * exception it throws. The `mode` enum specifies the strictness of the schema comparison.
+     * exception it throws. The `m_mode` option specifies the strictness of the schema comparison while the
+     * `m_layout` option specifies the shape of the returned value.
      */
-    octave_value load(simdjson::padded_string_view string, ParseMode mode);
+    octave_value load(simdjson::padded_string_view string, const Options& options);
 
     /**
      * @brief Load and parse a JSON string into an Octave value (multi-threaded).
      *
      * @param string The input string.
-     * @param mode Parse mode.
+     * @param options Parse options.
      *
      * @return The Octave value.
      *
      * @throw <internal_octave_error> if there is an error parsing the JSON string.
      *
      * I believe the `error` function provided by octave throws an exception, but I have no idea what
-     * exception it throws. The `mode` enum specifies the strictness of the schema comparison.
+     * exception it throws. The `m_mode` option specifies the strictness of the schema comparison while the
+     * `m_layout` option specifies the shape of the returned value.
+     */
+    octave_value load_multi(simdjson::padded_string_view string, const Options& options);
+
+    /**
+     * @brief Load and parse a batch of a JSON string into an Octave value (multi-threaded).
+     *
+     * @param string The input string.
+     * @param options Parse options.
+     * @param reference The reference from the previous batches, updated after this batch is loaded.
+     *
+     * @return The Octave value.
+     *
+     * @throw <internal_octave_error> if there is an error parsing the JSON string.
+     *
+     * Same as the other overload but the documents are checked against the reference instead of the first
+     * document of the string (unless the reference is not initialized yet).
      */
-    octave_value load_multi(simdjson::padded_string_view string, ParseMode mode);
+    octave_value load_multi(
+        simdjson::padded_string_view string,
+        const Options&               options,
+        Reference&                   reference
+    );
 }
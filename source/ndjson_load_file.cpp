@@ -1,16 +1,38 @@
 #include "args.hpp"
+#include "decompress.hpp"
+#include "line_index.hpp"
+#include "mapped_file.hpp"
 #include "ndjson_load.hpp"
+#include "result_cache.hpp"
+#include "stats.hpp"
+#include "util.hpp"
 
 #include <octave/defun-dld.h>
 #include <octave/error.h>
-#include <simdjson.h>
 
 #include <filesystem>
+#include <format>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <variant>
 
 static constexpr auto usage_string = R"(
 ndjson_load_file(
     filepath  : string,         % positional
     [mode     : enum_string],   % optional property
+    [layout   : enum_string],   % optional property
+    [threads  : integer],       % optional property
+    [batch_size: integer],      % optional property
+    [progress : logical],       % optional property
+    [fields   : cellstr],       % optional property
+    [where    : cell],          % optional property
+    [backend  : enum_string],   % optional property
+    [numeric  : enum_string],   % optional property
+    [index    : logical],       % optional property
+    [range    : vector],        % optional property
+    [cache    : logical],       % optional property
     [threading: enum_string]    % optional property
 )";
 
@@ -20,6 +42,17 @@ signature:
     ndjson_load_file(
         filepath  : string,         % positional
         [mode     : enum_string],   % optional property
+        [layout   : enum_string],   % optional property
+        [threads  : integer],       % optional property
+        [batch_size: integer],      % optional property
+        [progress : logical],       % optional property
+        [fields   : cellstr],       % optional property
+        [where    : cell],          % optional property
+        [backend  : enum_string],   % optional property
+        [numeric  : enum_string],   % optional property
+        [index    : logical],       % optional property
+        [range    : vector],        % optional property
+        [cache    : logical],       % optional property
         [threading: enum_string]    % optional property
     )
 
@@ -31,6 +64,78 @@ parameters:
         - dynarray : Documents have the same schema but the number of elements in array
                      and its types can vary.
         - relaxed  : Documents can have different schemas.
+        - union    : Documents can have different schemas. Object documents are merged into
+                     a struct array with every top-level key found in any document, the
+                     missing fields are filled with [] (NaN in the number columns of the
+                     columnar layout). Doesn't support [fields] nor [numeric].
+
+    > layout : Enumeration that specifies the shape of the output (object documents only).
+        - rows     : Return a struct array with one element for each document.
+        - columnar : Return a scalar struct with one column for each key. Numbers and
+                     booleans are stored as column vectors, others as cell arrays. All
+                     documents must have the same keys in the same order.
+
+    > threads : Number of threads used in multi-thread mode. Must be a positive integer.
+                Defaults to half of the available hardware threads.
+
+    > batch_size : Size in bytes of the batches the documents are parsed in, must be larger
+                   than the longest line in single-thread mode. Each thread parses its part
+                   of the input as one stream of documents, one per line, cut into batches
+                   of this size (a part with a longer line is parsed as a single batch in
+                   multi-thread mode). Defaults to 1000000 (1 MB).
+
+    > progress : Whether to print the progress while loading: the bytes and documents
+                 processed so far and the throughput, on a line updated every second. The
+                 main thread keeps checking for Ctrl-C while the other threads parse, so a
+                 long load can be interrupted at any time either way.
+
+    > fields : A string or a cell array of strings that specifies the fields to be decoded
+               (object documents only). Each field is specified by its path, the keys from the
+               root joined by a dot (e.g. 'b.c'). The rest of the document is ignored, including
+               on the schema comparison.
+
+    > where : A {field, op, value} cell, or a cell array of them, that specifies the predicates
+              a document must satisfy to be kept (all of them). The field is a path, same as
+              in [fields]. The op is one of '==', '~=', '<', '<=', '>', '>=', or 'prefix'. The
+              value is a string, a real or logical scalar, or [] for null. The predicates are
+              checked before the document is converted, a document without the field never
+              matches, a field of another type is never equal, the ordering ops only apply to
+              numbers, and 'prefix' only to strings. The first document that matches is the
+              reference of [mode].
+
+    > backend : Enumeration that specifies how the documents are parsed.
+        - dom      : Parse each document into a DOM tree first, then convert the tree.
+        - ondemand : Convert each document directly while parsing it. Faster on large
+                     documents, especially with [fields] since the fields that are not
+                     selected are skipped without being parsed. Doesn't support the
+                     columnar layout.
+
+    > numeric : Enumeration that specifies how the number columns are stored (columnar layout
+                only). The integer types are only used if the column has no null and no
+                non-integer (a number with a fraction or an exponent).
+        - double   : Store the numbers as double (default).
+        - preserve : Store the integers as int64 (uint64 if one doesn't fit), keeping the
+                     precision above 2^53.
+        - single   : Store the numbers as single.
+        - auto     : Store the numbers as the narrowest type that represents every number of
+                     the column exactly, from int8/uint8 up to int64/uint64, then single, then
+                     double. With [ndjson_next] the type is decided for each batch.
+
+    > index : Whether to use a line index, saved next to the file as [<filepath>.idx]. The
+              index is built on the first use (and rebuilt when the file changes) and makes
+              [range] start parsing right away instead of scanning the file from the start.
+              Defaults to false.
+
+    > range : A [first last] vector that specifies the lines to be loaded (1-based, inclusive,
+              last can be Inf). Empty lines are not counted. Line numbers on error messages are
+              still relative to the whole file. Without [index] the file is scanned for the
+              start of the range on each call (without parsing it).
+
+    > cache : Whether to cache the result, saved next to the file as [<filepath>.cache]. The
+              first load saves the result in a binary form, the next loads with the same [mode],
+              [layout], [numeric], [fields], [where], and [range] read it back without parsing
+              any JSON.
+              The cache is invalidated when the file changes. Defaults to false.
 
     > threading : Threading mode.
         - single : Run in single-thread mode.
@@ -66,6 +171,20 @@ behavior:
 
     The single-thread mode don't have this constraint.
 
+    A file compressed with gzip ([.gz]) or zstd ([.zst]) is detected from its content and
+    decompressed into memory before being parsed. A zstd file made of multiple frames (e.g.
+    compressed with [pzstd] or in the seekable format) is decompressed in parallel.
+
+    With a second output, [[x, stats] = ndjson_load_file(...)], the function also returns
+    where the time went. [stats.wall] has the wall time in seconds of each phase: read
+    (mapping, decompressing, and indexing the file), split (cutting the input into chunks),
+    parse, and assemble (building the result). The file is mapped, so reading the pages
+    from the disk is counted in parse. Each element of [stats.threads] has the busy time of
+    a thread split into parse, decode, and schema (in seconds), the bytes and documents it
+    processed, and the number of decode temporaries that didn't fit in its arena. A result
+    read from the cache has no thread. [stats.enabled] is false if the stats are compiled
+    out (NDJSON_STATS=OFF), there is no other field then.
+
 example:
     For example, a [data.jsonl] file with content:
     ```
@@ -97,9 +216,178 @@ example:
 namespace fs     = std::filesystem;
 namespace ndjson = octave_ndjson;
 
-DEFUN_DLD(ndjson_load_file, args, , usage_string)
+namespace
 {
-    auto [path, mode, threading] = ndjson::args::parse(args, ndjson::args::Kind::File, help_string);
+    /**
+     * @brief Load the index saved next to the file, or build it if it's missing or stale.
+     *
+     * @param save Whether to save the index if it's built, failing to save it is not an error.
+     */
+    ndjson::LineIndex get_index(const std::string& path, std::string_view content, bool save)
+    {
+        auto index_path = ndjson::LineIndex::path_for(path);
+        auto stamp      = ndjson::FileStamp::of(path);
+
+        if (save) {
+            if (auto index = ndjson::LineIndex::load(index_path, stamp)) {
+                return std::move(*index);
+            }
+        }
+
+        auto index = ndjson::LineIndex{ content, stamp };
+        if (save) {
+            try {
+                index.save(index_path);
+            } catch (const std::system_error&) {
+                // e.g. read-only directory, the index is only a cache
+            }
+        }
+        return index;
+    }
+
+    /**
+     * @brief Load the file (or the range of lines) without the result cache.
+     */
+    octave_value load_file(
+        const std::string&            path,
+        ndjson::Options               options,
+        ndjson::args::Threading       threading,
+        const ndjson::args::FileArgs& file_args
+    )
+    {
+        auto stats = options.m_stats;
+        auto read  = ndjson::Stats::Timer{ stats ? &stats->wall(ndjson::Stats::Phase::Read) : nullptr };
+
+        auto file = std::optional<ndjson::MappedFile>{};
+        try {
+            file.emplace(path);
+        } catch (const std::system_error& e) {
+            error("Failed to load file '%s': %s", path.c_str(), e.what());
+        }
+
+        // a compressed file is decompressed into memory first, the rest works on the decompressed content
+        auto view         = file->view();
+        auto decompressed = std::string{};
+
+        if (auto compression = ndjson::detect_compression({ view.data(), view.size() });
+            compression != ndjson::Compression::None) {
+            try {
+                auto concurrency = threading == ndjson::args::Threading::Single
+                                     ? 1ul
+                                     : ndjson::concurrency(options);
+                decompressed = ndjson::decompress({ view.data(), view.size() }, compression, concurrency);
+            } catch (const std::runtime_error& e) {
+                error("Failed to decompress file '%s': %s", path.c_str(), e.what());
+            }
+            view = simdjson::padded_string_view{
+                decompressed.data(),
+                decompressed.size(),
+                decompressed.capacity(),
+            };
+        }
+
+        if (file_args.m_index or file_args.m_range) {
+            auto index = std::optional<ndjson::LineIndex>{};
+            try {
+                index.emplace(get_index(path, { view.data(), view.size() }, file_args.m_index));
+            } catch (const std::system_error& e) {
+                error("Failed to index file '%s': %s", path.c_str(), e.what());
+            }
+
+            if (file_args.m_range) {
+                auto [first, last] = *file_args.m_range;
+                if (first >= index->lines()) {
+                    auto lines = index->lines();
+                    error("Range starts at line %zu but the file only has %zu lines", first + 1, lines);
+                }
+
+                // the lines of a range are loaded as a single batch starting at `first`, so the line numbers
+                // on error messages are still relative to the whole file; the rest of the file after the
+                // slice serves as the padding
+                auto slice     = index->slice({ view.data(), view.size() }, first, last);
+                auto capacity  = view.capacity() - static_cast<std::size_t>(slice.data() - view.data());
+                auto padded    = simdjson::padded_string_view{ slice.data(), slice.size(), capacity };
+                auto reference = ndjson::Reference{ .m_lines = first };
+
+                if (threading == ndjson::args::Threading::Single) {
+                    options.m_threads = 1;
+                }
+
+                read.stop();
+                return ndjson::load_multi(padded, options, reference);
+            }
+        }
+
+        read.stop();
+
+        switch (threading) {
+        case ndjson::args::Threading::Single: return ndjson::load(view, options);
+        case ndjson::args::Threading::Multi: return ndjson::load_multi(view, options);
+        default: [[unlikely]] std::abort();
+        }
+    }
+
+    /**
+     * @brief Identify the options that affect the result, so a cache saved with other options is not used.
+     */
+    std::string cache_key(const ndjson::Options& options, const ndjson::args::FileArgs& file_args)
+    {
+        auto key = std::format(
+            "mode={} layout={} numeric={}",
+            static_cast<int>(options.m_mode),
+            static_cast<int>(options.m_layout),
+            static_cast<int>(options.m_numeric)
+        );
+
+        if (file_args.m_range) {
+            key += std::format(" range={}:{}", file_args.m_range->first, file_args.m_range->second);
+        }
+        if (options.m_fields) {
+            key += " fields=";
+            for (const auto& path : options.m_fields->paths()) {
+                key += std::format("{}:{};", path.size(), path);    // length-prefixed, keys can be anything
+            }
+        }
+        if (options.m_where) {
+            key += " where=";
+            for (const auto& [path, op, value] : options.m_where->predicates()) {
+                auto visit = util::Overload{
+                    [](std::nullptr_t) { return std::string{ "null" }; },
+                    [](bool value) { return std::format("bool:{}", value); },
+                    [](double value) { return std::format("number:{}", value); },
+                    [](const std::string& value) { return std::format("string:{}:{}", value.size(), value); },
+                };
+                auto op_int = static_cast<int>(op);
+                key += std::format("{}:{}:{}:{};", path.size(), path, op_int, std::visit(visit, value));
+            }
+        }
+
+        return key;
+    }
+
+    /**
+     * @brief Make the outputs of the function, the stats are only converted if they're asked for.
+     */
+    octave_value_list outputs(const octave_value& result, const ndjson::Stats& stats, int nargout)
+    {
+        if (nargout > 1) {
+            return octave_value_list{ result, stats.to_octave() };
+        }
+        return octave_value_list{ result };
+    }
+}
+
+DEFUN_DLD(ndjson_load_file, args, nargout, usage_string)
+{
+    auto [path, options, threading, file_args] = ndjson::args::parse(
+        args, ndjson::args::Kind::File, help_string
+    );
+
+    // the stats are only collected if they're asked for
+    auto stats = ndjson::Stats{};
+    if (nargout > 1) {
+        options.m_stats = &stats;
+    }
 
     if (not fs::exists(path)) {
         error("File '%s' does not exist", path.c_str());
@@ -107,14 +395,30 @@ DEFUN_DLD(ndjson_load_file, args, , usage_string)
         error("File '%s' is not a regular file", path.c_str());
     }
 
-    auto padded_string = simdjson::padded_string::load(path);
-    if (padded_string.error()) {
-        error("Failed to load file '%s': %s", path.c_str(), simdjson::error_message(padded_string.error()));
+    if (not file_args.m_cache) {
+        return outputs(load_file(path, options, threading, file_args), stats, nargout);
+    }
+
+    // the stamp is taken before loading, a file modified while being loaded leaves a stale cache behind
+    auto stamp = ndjson::FileStamp{};
+    try {
+        stamp = ndjson::FileStamp::of(path);
+    } catch (const std::system_error& e) {
+        error("Failed to load file '%s': %s", path.c_str(), e.what());
+    }
+
+    auto cache_path = path + ".cache";
+    auto key        = cache_key(options, file_args);
+
+    if (auto cached = ndjson::load_result(cache_path, stamp, key)) {
+        return outputs(*cached, stats, nargout);    // nothing is loaded, so the stats are all zero
     }
 
-    switch (threading) {
-    case ndjson::args::Threading::Single: return ndjson::load(padded_string.value(), mode);
-    case ndjson::args::Threading::Multi: return ndjson::load_multi(padded_string.value(), mode);
-    default: [[unlikely]] std::abort();
+    auto result = load_file(path, options, threading, file_args);
+    try {
+        ndjson::save_result(cache_path, stamp, key, result);
+    } catch (const std::exception&) {
+        // e.g. read-only directory, the cache is optional
     }
+    return outputs(result, stats, nargout);
 }
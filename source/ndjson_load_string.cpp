@@ -1,5 +1,6 @@
 #include "args.hpp"
 #include "ndjson_load.hpp"
+#include "stats.hpp"
 
 #include <octave/defun-dld.h>
 #include <simdjson.h>
@@ -8,6 +9,14 @@ static constexpr auto usage_string = R"(
 ndjson_load_string(
     json_string: string,         % positional
     [mode      : enum_string],   % optional property
+    [layout    : enum_string],   % optional property
+    [threads   : integer],       % optional property
+    [batch_size: integer],       % optional property
+    [progress  : logical],       % optional property
+    [fields    : cellstr],       % optional property
+    [where     : cell],          % optional property
+    [backend   : enum_string],   % optional property
+    [numeric   : enum_string],   % optional property
     [threading : enum_string]    % optional property
 )
 )";
@@ -18,6 +27,14 @@ signature:
     ndjson_load_string(
         json_string: string,         % positional
         [mode      : enum_string],   % optional property
+        [layout    : enum_string],   % optional property
+        [threads   : integer],       % optional property
+        [batch_size: integer],       % optional property
+        [progress  : logical],       % optional property
+        [fields    : cellstr],       % optional property
+        [where     : cell],          % optional property
+        [backend   : enum_string],   % optional property
+        [numeric   : enum_string],   % optional property
         [threading : enum_string]    % optional property
     )
 
@@ -29,6 +46,62 @@ parameters:
         - dynarray : Documents have the same schema but the number of elements in array
                      and its types can vary.
         - relaxed  : Documents can have different schemas.
+        - union    : Documents can have different schemas. Object documents are merged into
+                     a struct array with every top-level key found in any document, the
+                     missing fields are filled with [] (NaN in the number columns of the
+                     columnar layout). Doesn't support [fields] nor [numeric].
+
+    > layout : Enumeration that specifies the shape of the output (object documents only).
+        - rows     : Return a struct array with one element for each document.
+        - columnar : Return a scalar struct with one column for each key. Numbers and
+                     booleans are stored as column vectors, others as cell arrays. All
+                     documents must have the same keys in the same order.
+
+    > threads : Number of threads used in multi-thread mode. Must be a positive integer.
+                Defaults to half of the available hardware threads.
+
+    > batch_size : Size in bytes of the batches the documents are parsed in, must be larger
+                   than the longest line in single-thread mode. Each thread parses its part
+                   of the input as one stream of documents, one per line, cut into batches
+                   of this size (a part with a longer line is parsed as a single batch in
+                   multi-thread mode). Defaults to 1000000 (1 MB).
+
+    > progress : Whether to print the progress while loading: the bytes and documents
+                 processed so far and the throughput, on a line updated every second. The
+                 main thread keeps checking for Ctrl-C while the other threads parse, so a
+                 long load can be interrupted at any time either way.
+
+    > fields : A string or a cell array of strings that specifies the fields to be decoded
+               (object documents only). Each field is specified by its path, the keys from the
+               root joined by a dot (e.g. 'b.c'). The rest of the document is ignored, including
+               on the schema comparison.
+
+    > where : A {field, op, value} cell, or a cell array of them, that specifies the predicates
+              a document must satisfy to be kept (all of them). The field is a path, same as
+              in [fields]. The op is one of '==', '~=', '<', '<=', '>', '>=', or 'prefix'. The
+              value is a string, a real or logical scalar, or [] for null. The predicates are
+              checked before the document is converted, a document without the field never
+              matches, a field of another type is never equal, the ordering ops only apply to
+              numbers, and 'prefix' only to strings. The first document that matches is the
+              reference of [mode].
+
+    > backend : Enumeration that specifies how the documents are parsed.
+        - dom      : Parse each document into a DOM tree first, then convert the tree.
+        - ondemand : Convert each document directly while parsing it. Faster on large
+                     documents, especially with [fields] since the fields that are not
+                     selected are skipped without being parsed. Doesn't support the
+                     columnar layout.
+
+    > numeric : Enumeration that specifies how the number columns are stored (columnar layout
+                only). The integer types are only used if the column has no null and no
+                non-integer (a number with a fraction or an exponent).
+        - double   : Store the numbers as double (default).
+        - preserve : Store the integers as int64 (uint64 if one doesn't fit), keeping the
+                     precision above 2^53.
+        - single   : Store the numbers as single.
+        - auto     : Store the numbers as the narrowest type that represents every number of
+                     the column exactly, from int8/uint8 up to int64/uint64, then single, then
+                     double. With [ndjson_next] the type is decided for each batch.
 
     > threading : Threading mode.
         - single : Run in single-thread mode.
@@ -64,6 +137,14 @@ behavior:
 
     The single-thread mode don't have this constraint.
 
+    With a second output, [[x, stats] = ndjson_load_string(...)], the function also returns
+    where the time went. [stats.wall] has the wall time in seconds of each phase: split
+    (cutting the input into chunks), parse, and assemble (building the result). Each
+    element of [stats.threads] has the busy time of a thread split into parse, decode, and
+    schema (in seconds), the bytes and documents it processed, and the number of decode
+    temporaries that didn't fit in its arena. [stats.enabled] is false if the stats are
+    compiled out (NDJSON_STATS=OFF), there is no other field then.
+
 example:
     For example, a variable [data] which is a string with content:
     ```
@@ -94,14 +175,28 @@ example:
 
 namespace ndjson = octave_ndjson;
 
-DEFUN_DLD(ndjson_load_string, args, , usage_string)
+DEFUN_DLD(ndjson_load_string, args, nargout, usage_string)
 {
-    auto [string, mode, threading] = ndjson::args::parse(args, ndjson::args::Kind::String, help_string);
-    auto padded_string             = simdjson::pad(string);
+    auto [string, options, threading, file_args] = ndjson::args::parse(
+        args, ndjson::args::Kind::String, help_string
+    );
+    auto padded_string                           = simdjson::pad(string);
+
+    // the stats are only collected if they're asked for
+    auto stats = ndjson::Stats{};
+    if (nargout > 1) {
+        options.m_stats = &stats;
+    }
 
+    auto result = octave_value{};
     switch (threading) {
-    case ndjson::args::Threading::Single: return ndjson::load(padded_string, mode);
-    case ndjson::args::Threading::Multi: return ndjson::load_multi(padded_string, mode);
+    case ndjson::args::Threading::Single: result = ndjson::load(padded_string, options); break;
+    case ndjson::args::Threading::Multi: result = ndjson::load_multi(padded_string, options); break;
     default: [[unlikely]] std::abort();
     }
+
+    if (nargout > 1) {
+        return octave_value_list{ result, stats.to_octave() };
+    }
+    return octave_value_list{ result };
 }
@@ -0,0 +1,298 @@
+#include "args.hpp"
+#include "ndjson_load.hpp"
+#include "stream.hpp"
+
+#include <octave/defun-dld.h>
+#include <octave/error.h>
+#include <octave/ov.h>
+
+#include <cmath>
+#include <filesystem>
+#include <limits>
+#include <map>
+#include <memory>
+#include <system_error>
+
+// NOTE: ndjson_follow, ndjson_next, and ndjson_close are defined here too so they share the open streams,
+// octave finds them through symlinks to this file named after each function (see CMakeLists.txt).
+
+static constexpr auto open_usage_string = R"(
+ndjson_open(
+    filepath  : string,         % positional
+    [mode     : enum_string],   % optional property
+    [layout   : enum_string],   % optional property
+    [threads  : integer],       % optional property
+    [batch_size: integer],      % optional property
+    [progress : logical],       % optional property
+    [fields   : cellstr],       % optional property
+    [where    : cell],          % optional property
+    [backend  : enum_string],   % optional property
+    [numeric  : enum_string],   % optional property
+    [threading: enum_string]    % optional property
+)
+)";
+
+static constexpr auto open_help_string = R"(
+================================= ndjson_open help page ==================================
+signature:
+    ndjson_open(
+        filepath  : string,         % positional
+        [mode     : enum_string],   % optional property
+        [layout   : enum_string],   % optional property
+        [threads  : integer],       % optional property
+        [batch_size: integer],      % optional property
+        [progress : logical],       % optional property
+        [fields   : cellstr],       % optional property
+        [where    : cell],          % optional property
+        [backend  : enum_string],   % optional property
+        [numeric  : enum_string],   % optional property
+        [threading: enum_string]    % optional property
+    )
+
+parameters:
+    > filepath : Path to an NDJSON/JSON Lines file.
+
+    The rest of the parameters are the same as [ndjson_load_file], see its help page.
+
+behavior:
+    Open a file for streaming and return a handle to it. The documents are then loaded in
+    batches using [ndjson_next] and the handle must be closed using [ndjson_close].
+
+    The file is read in bounded-size chunks, so only the documents of the current batch
+    are kept in memory. This allows loading files that are larger than the available
+    memory. Every batch is checked against the first document of the file using the
+    given [mode] and the line numbering on error messages continues across batches.
+
+    Setting [threading] to 'single' is the same as setting [threads] to 1.
+
+example:
+    ```
+        octave> h = ndjson_open('data.jsonl');
+        octave> while true
+        >           b = ndjson_next(h, 10000);
+        >           if isempty(b), break; end
+        >           % process the batch...
+        >       end
+        octave> ndjson_close(h);
+    ```
+==========================================================================================
+)";
+
+static constexpr auto follow_usage_string = R"(
+ndjson_follow(
+    filepath  : string,         % positional
+    [mode     : enum_string],   % optional property
+    [layout   : enum_string],   % optional property
+    [threads  : integer],       % optional property
+    [batch_size: integer],      % optional property
+    [progress : logical],       % optional property
+    [fields   : cellstr],       % optional property
+    [where    : cell],          % optional property
+    [backend  : enum_string],   % optional property
+    [numeric  : enum_string],   % optional property
+    [threading: enum_string]    % optional property
+)
+)";
+
+static constexpr auto follow_help_string = R"(
+================================ ndjson_follow help page =================================
+signature:
+    ndjson_follow(
+        filepath  : string,         % positional
+        [mode     : enum_string],   % optional property
+        [layout   : enum_string],   % optional property
+        [threads  : integer],       % optional property
+        [batch_size: integer],      % optional property
+        [progress : logical],       % optional property
+        [fields   : cellstr],       % optional property
+        [where    : cell],          % optional property
+        [backend  : enum_string],   % optional property
+        [numeric  : enum_string],   % optional property
+        [threading: enum_string]    % optional property
+    )
+
+parameters:
+    > filepath : Path to an NDJSON/JSON Lines file.
+
+    The rest of the parameters are the same as [ndjson_load_file], see its help page.
+
+behavior:
+    Same as [ndjson_open] but for a file that is still being appended to. Reaching the end
+    of file is not final: the next call to [ndjson_next] continues from the last consumed
+    byte and only reads and parses what has been appended since, so the cost of each call
+    scales with the new data instead of the file size. The new documents are checked
+    against the first document of the file.
+
+    The last line is only loaded once its newline is written, since the writer may still
+    be in the middle of it. If the file is truncated, it is read again from the beginning.
+
+example:
+    ```
+        octave> h = ndjson_follow('simulation.jsonl');
+        octave> data = ndjson_next(h, Inf);         % everything written so far
+        octave> % ... some time later
+        octave> data = [data, ndjson_next(h, Inf)]; % only the appended documents
+        octave> ndjson_close(h);
+    ```
+==========================================================================================
+)";
+
+static constexpr auto next_usage_string = R"(
+ndjson_next(
+    handle: scalar,   % positional
+    [count: integer]  % positional, optional (default: 1000)
+)
+)";
+
+static constexpr auto next_help_string = R"(
+================================= ndjson_next help page ==================================
+signature:
+    ndjson_next(
+        handle: scalar,   % positional
+        [count: integer]  % positional, optional (default: 1000)
+    )
+
+parameters:
+    > handle : A handle returned by [ndjson_open] or [ndjson_follow].
+    > count  : Maximum number of documents to load, Inf loads every document left.
+
+behavior:
+    Load the next batch of at most [count] documents. The batch has the same shape as what
+    [ndjson_load_file] would return for the same documents. An empty matrix is returned
+    when there is no document left (no new document for [ndjson_follow]).
+==========================================================================================
+)";
+
+static constexpr auto close_usage_string = R"(
+ndjson_close(
+    handle: scalar    % positional
+)
+)";
+
+static constexpr auto close_help_string = R"(
+================================= ndjson_close help page =================================
+signature:
+    ndjson_close(
+        handle: scalar    % positional
+    )
+
+parameters:
+    > handle : A handle returned by [ndjson_open] or [ndjson_follow].
+
+behavior:
+    Close the file and release the handle.
+==========================================================================================
+)";
+
+namespace fs     = std::filesystem;
+namespace ndjson = octave_ndjson;
+
+namespace
+{
+    auto g_streams     = std::map<std::size_t, std::unique_ptr<ndjson::Stream>>{};
+    auto g_next_handle = 1ul;
+
+    ndjson::Stream& get_stream(const octave_value& handle, const char* error_prefix)
+    {
+        if (not handle.isnumeric() or not handle.is_real_scalar()) {
+            error("%s\nExpected a stream handle", error_prefix);
+        }
+
+        auto value = handle.double_value();
+        auto found = g_streams.end();
+        if (value >= 1 and value == std::floor(value)) {
+            found = g_streams.find(static_cast<std::size_t>(value));
+        }
+
+        if (found == g_streams.end()) {
+            error("%s\nInvalid stream handle '%g'", error_prefix, value);
+        }
+        return *found->second;
+    }
+
+    octave_value open_stream(const octave_value_list& args, const char* help_string, bool follow)
+    {
+        auto [path, options, threading, file_args] = ndjson::args::parse(
+            args, ndjson::args::Kind::File, help_string
+        );
+
+        if (file_args.m_index or file_args.m_cache or file_args.m_range) {
+            error("%s\nParameters 'index', 'cache', and 'range' are not supported by streams", help_string);
+        }
+
+        if (not fs::exists(path)) {
+            error("File '%s' does not exist", path.c_str());
+        } else if (not fs::is_regular_file(path)) {
+            error("File '%s' is not a regular file", path.c_str());
+        }
+
+        if (threading == ndjson::args::Threading::Single) {
+            options.m_threads = 1;
+        }
+
+        auto stream = std::unique_ptr<ndjson::Stream>{};
+        try {
+            stream = std::make_unique<ndjson::Stream>(path, options, follow);
+        } catch (const std::system_error& e) {
+            error("Failed to open file '%s': %s", path.c_str(), e.what());
+        }
+
+        auto handle = g_next_handle++;
+        g_streams.emplace(handle, std::move(stream));
+
+        return octave_value{ static_cast<double>(handle) };
+    }
+}
+
+DEFUN_DLD(ndjson_open, args, , open_usage_string)
+{
+    return open_stream(args, open_help_string, false);
+}
+
+DEFUN_DLD(ndjson_follow, args, , follow_usage_string)
+{
+    return open_stream(args, follow_help_string, true);
+}
+
+DEFUN_DLD(ndjson_next, args, , next_usage_string)
+{
+    if (args.length() < 1 or args.length() > 2) {
+        error("%s\nIncorrect number of arguments, 1 or 2 are required.", next_help_string);
+    }
+
+    auto& stream = get_stream(args(0), next_help_string);
+    auto  count  = 1000.0;
+
+    if (args.length() == 2) {
+        if (not args(1).isnumeric() or not args(1).is_real_scalar()) {
+            error("%s\nExpected a positive integer or Inf value for 'count'", next_help_string);
+        }
+
+        count = args(1).double_value();
+        if (count < 1 or count != std::floor(count)) {
+            error("%s\nInvalid value '%g' for 'count'", next_help_string, count);
+        }
+    }
+
+    // std::floor(Inf) is Inf, so Inf passes the check above
+    auto limit = std::isinf(count) ? std::numeric_limits<std::size_t>::max()
+                                   : static_cast<std::size_t>(count);
+
+    try {
+        return stream.next(limit);
+    } catch (const std::system_error& e) {
+        error("Failed to read file: %s", e.what());
+    }
+}
+
+DEFUN_DLD(ndjson_close, args, , close_usage_string)
+{
+    if (args.length() != 1) {
+        error("%s\nIncorrect number of arguments, 1 is required.", close_help_string);
+    }
+
+    get_stream(args(0), close_help_string);
+    g_streams.erase(static_cast<std::size_t>(args(0).double_value()));
+
+    return octave_value_list{};
+}
@@ -0,0 +1,422 @@
+#include "ndjson_save.hpp"
+
+#include "thread_pool.hpp"
+
+#include <octave/Cell.h>
+#include <octave/boolNDArray.h>
+#include <octave/chNDArray.h>
+#include <octave/dNDArray.h>
+#include <octave/fNDArray.h>
+#include <octave/int16NDArray.h>
+#include <octave/int32NDArray.h>
+#include <octave/int64NDArray.h>
+#include <octave/int8NDArray.h>
+#include <octave/oct-map.h>
+#include <octave/ov.h>
+#include <octave/uint16NDArray.h>
+#include <octave/uint32NDArray.h>
+#include <octave/uint64NDArray.h>
+#include <octave/uint8NDArray.h>
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <climits>
+#include <cmath>
+#include <format>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace octave_ndjson::detail
+{
+    void encode(std::string& out, const octave_value& value);
+
+    void write_string(std::string& out, std::string_view string)
+    {
+        static constexpr auto hex = std::string_view{ "0123456789abcdef" };
+
+        out += '"';
+
+        // the characters that need no escaping are appended in runs
+        auto begin = 0ul;
+        for (auto i = 0ul; i < string.size(); ++i) {
+            auto ch = static_cast<unsigned char>(string[i]);
+            if (ch >= 0x20 and ch != '"' and ch != '\\') {
+                continue;
+            }
+
+            out.append(string.substr(begin, i - begin));
+            switch (ch) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\t': out += "\\t"; break;
+            case '\r': out += "\\r"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            default: out += "\\u00"; out += hex[ch >> 4]; out += hex[ch & 0xF]; break;
+            }
+            begin = i + 1;
+        }
+
+        out.append(string.substr(begin));
+        out += '"';
+    }
+
+    /**
+     * @brief Write a number in its shortest form that parses back to the same value.
+     */
+    template <typename T>
+    void write_number(std::string& out, T value)
+    {
+        if constexpr (std::is_floating_point_v<T>) {
+            if (not std::isfinite(value)) {
+                out += "null";
+                return;
+            }
+        }
+
+        auto buffer   = std::array<char, 32>{};
+        auto [end, _] = std::to_chars(buffer.data(), buffer.data() + buffer.size(), value);
+        out.append(buffer.data(), end);
+    }
+
+    void write_element(std::string& out, double value) { write_number(out, value); }
+    void write_element(std::string& out, float value) { write_number(out, value); }
+    void write_element(std::string& out, bool value) { out += value ? "true" : "false"; }
+
+    template <typename T>
+    void write_element(std::string& out, octave_int<T> value)
+    {
+        write_number(out, value.value());
+    }
+
+    /**
+     * @brief Write the elements along a dimension as an array, recursing into the next dimensions.
+     *
+     * The first dimension is the outermost, so a matrix is written as an array of its rows.
+     */
+    template <typename Write>
+    void write_nested(
+        std::string&      out,
+        const dim_vector& dims,
+        int               dim,
+        long              offset,
+        long              stride,
+        Write&            write
+    )
+    {
+        out += '[';
+        for (auto i = 0l; i < dims(dim); ++i) {
+            if (i != 0) {
+                out += ',';
+            }
+
+            if (dim + 1 == dims.ndims()) {
+                write(offset + i * stride);
+            } else {
+                write_nested(out, dims, dim + 1, offset + i * stride, stride * dims(dim), write);
+            }
+        }
+        out += ']';
+    }
+
+    /**
+     * @brief Write the elements of an array of any dimensions.
+     *
+     * @param out The output.
+     * @param dims The dimensions of the array.
+     * @param write Writes the element at a linear index.
+     *
+     * A vector (either a row or a column) is written as a flat array.
+     */
+    template <typename Write>
+    void write_array(std::string& out, const dim_vector& dims, Write&& write)
+    {
+        auto numel = dims.numel();
+        if (numel == 0) {
+            out += "[]";
+        } else if (dims.ndims() == 2 and (dims(0) == 1 or dims(1) == 1)) {
+            out += '[';
+            for (auto i = 0l; i < numel; ++i) {
+                if (i != 0) {
+                    out += ',';
+                }
+                write(i);
+            }
+            out += ']';
+        } else {
+            write_nested(out, dims, 0, 0, 1, write);
+        }
+    }
+
+    template <typename Array>
+    void write_numeric(std::string& out, const Array& array)
+    {
+        const auto* data = array.data();
+        if (array.numel() == 1) {
+            write_element(out, data[0]);
+        } else {
+            write_array(out, array.dims(), [&](long i) { write_element(out, data[i]); });
+        }
+    }
+
+    void write_chars(std::string& out, const charNDArray& chars)
+    {
+        const auto* data = chars.data();
+        auto        rows = chars.dims()(0);
+
+        if (rows <= 1) {
+            write_string(out, { data, static_cast<std::size_t>(chars.numel()) });
+            return;
+        } else if (chars.ndims() > 2) {
+            throw std::runtime_error{ "Unsupported char array with more than 2 dimensions" };
+        }
+
+        // a char matrix is an array of its rows, the rows are strided in column-major order
+        auto cols = chars.dims()(1);
+        auto row  = std::string(static_cast<std::size_t>(cols), '\0');
+
+        out += '[';
+        for (auto i = 0l; i < rows; ++i) {
+            for (auto j = 0l; j < cols; ++j) {
+                row[static_cast<std::size_t>(j)] = data[i + j * rows];
+            }
+            if (i != 0) {
+                out += ',';
+            }
+            write_string(out, row);
+        }
+        out += ']';
+    }
+
+    /**
+     * @brief Write an object from its keys and a function that gets the value of each key.
+     */
+    template <typename Get>
+    void write_object(std::string& out, const string_vector& keys, Get&& get)
+    {
+        out += '{';
+        for (auto i = 0l; i < keys.numel(); ++i) {
+            if (i != 0) {
+                out += ',';
+            }
+            write_string(out, keys(i));
+            out += ':';
+            encode(out, get(i));
+        }
+        out += '}';
+    }
+
+    void write_struct(std::string& out, const octave_value& value)
+    {
+        // const, the non-const accessors unshare the storage (copying every field of a struct array)
+        if (value.numel() == 1) {
+            const auto map = value.scalar_map_value();
+            auto get = [&](long i) -> const octave_value& { return map.contents(i); };
+            write_object(out, map.fieldnames(), get);
+            return;
+        }
+
+        const auto map  = value.map_value();
+        const auto keys = map.fieldnames();
+        write_array(out, map.dims(), [&](long k) {
+            write_object(out, keys, [&](long i) -> const octave_value& { return map.contents(i)(k); });
+        });
+    }
+
+    void write_cell(std::string& out, const Cell& cell)
+    {
+        write_array(out, cell.dims(), [&](long i) { encode(out, cell(i)); });
+    }
+
+    std::runtime_error unsupported(const octave_value& value)
+    {
+        return std::runtime_error{ std::format("Unsupported value of class '{}'", value.class_name()) };
+    }
+
+    void encode(std::string& out, const octave_value& value)
+    {
+        // clang-format off
+        if      (value.is_char_matrix())  write_chars(out, value.char_array_value());
+        else if (value.isstruct())        write_struct(out, value);
+        else if (value.iscell())          write_cell(out, value.cell_value());
+        else if (value.islogical())       write_numeric(out, value.bool_array_value());
+        else if (not value.isreal())      throw std::runtime_error{ "Unsupported complex number" };
+        else if (value.is_double_type())  write_numeric(out, value.array_value());
+        else if (value.is_single_type())  write_numeric(out, value.float_array_value());
+        else if (value.is_int8_type())    write_numeric(out, value.int8_array_value());
+        else if (value.is_int16_type())   write_numeric(out, value.int16_array_value());
+        else if (value.is_int32_type())   write_numeric(out, value.int32_array_value());
+        else if (value.is_int64_type())   write_numeric(out, value.int64_array_value());
+        else if (value.is_uint8_type())   write_numeric(out, value.uint8_array_value());
+        else if (value.is_uint16_type())  write_numeric(out, value.uint16_array_value());
+        else if (value.is_uint32_type())  write_numeric(out, value.uint32_array_value());
+        else if (value.is_uint64_type())  write_numeric(out, value.uint64_array_value());
+        else                              throw unsupported(value);
+        // clang-format on
+    }
+
+    /**
+     * @brief Encode the rows in tasks of consecutive rows, each task into its own buffer.
+     *
+     * @param rows Number of rows.
+     * @param concurrency Number of threads.
+     * @param encode_row Encodes a row into a buffer.
+     *
+     * @return The buffers in the order of the rows.
+     */
+    template <typename Encode>
+    std::vector<std::string> encode_tasks(std::size_t rows, std::size_t concurrency, Encode&& encode_row)
+    {
+        static constexpr auto rows_per_task = 1024ul;
+
+        auto buffers = std::vector<std::string>((rows + rows_per_task - 1) / rows_per_task);
+        auto next    = std::atomic<std::size_t>{ 0 };
+
+        if (buffers.empty()) {
+            return buffers;
+        }
+
+        ThreadPool::instance().run(std::min(concurrency, buffers.size()), [&](std::size_t) {
+            for (auto task = next++; task < buffers.size(); task = next++) {
+                auto& out = buffers[task];
+                auto  end = std::min((task + 1) * rows_per_task, rows);
+                for (auto row = task * rows_per_task; row < end; ++row) {
+                    encode_row(out, static_cast<long>(row));
+                    out += '\n';
+                }
+            }
+        });
+
+        return buffers;
+    }
+
+    std::vector<std::string> encode_rows(const octave_value& value, std::size_t concurrency)
+    {
+        auto rows = static_cast<std::size_t>(value.numel());
+
+        // const, the non-const accessors unshare the storage of the value, which would race between the
+        // threads since the storage is shared with the caller's variable
+        if (value.isstruct() and rows != 1) {
+            const auto map  = value.map_value();
+            const auto keys = map.fieldnames();
+            return encode_tasks(rows, concurrency, [&](std::string& out, long k) {
+                write_object(out, keys, [&](long i) -> const octave_value& { return map.contents(i)(k); });
+            });
+        } else if (value.iscell()) {
+            const auto cell = value.cell_value();
+            return encode_tasks(rows, concurrency, [&](std::string& out, long k) { encode(out, cell(k)); });
+        }
+
+        return encode_tasks(1, 1, [&](std::string& out, long) { encode(out, value); });
+    }
+
+    /**
+     * @brief RAII wrapper for a file descriptor opened for writing.
+     */
+    struct OutputFile
+    {
+        int m_fd;
+
+        ~OutputFile()
+        {
+            if (m_fd >= 0) {
+                ::close(m_fd);
+            }
+        }
+    };
+
+    [[noreturn]] void throw_write_errno(const char* what)
+    {
+        throw std::system_error{ errno, std::generic_category(), what };
+    }
+
+    /**
+     * @brief Write the buffers in order, as few `writev` calls as possible.
+     *
+     * A call may write less than requested (e.g. more than 2 GiB on Linux), the rest is written by the next
+     * call.
+     */
+    void write_buffers(int fd, std::span<const std::string> buffers)
+    {
+        auto iovecs = std::vector<iovec>{};
+        for (const auto& buffer : buffers) {
+            if (not buffer.empty()) {
+                iovecs.push_back({ const_cast<char*>(buffer.data()), buffer.size() });
+            }
+        }
+
+        auto pending = std::span{ iovecs };
+        while (not pending.empty()) {
+            auto count   = static_cast<int>(std::min(pending.size(), static_cast<std::size_t>(IOV_MAX)));
+            auto written = ::writev(fd, pending.data(), count);
+            if (written < 0 and errno == EINTR) {
+                continue;
+            } else if (written < 0) {
+                throw_write_errno("writev");
+            }
+
+            // drop the buffers written in full, then advance into the one written partially
+            auto left = static_cast<std::size_t>(written);
+            while (not pending.empty() and left >= pending.front().iov_len) {
+                left    -= pending.front().iov_len;
+                pending  = pending.subspan(1);
+            }
+            if (left > 0) {
+                pending.front().iov_base  = static_cast<char*>(pending.front().iov_base) + left;
+                pending.front().iov_len  -= left;
+            }
+        }
+    }
+}
+
+namespace octave_ndjson
+{
+    std::string dump(const octave_value& value, std::size_t concurrency)
+    {
+        auto buffers = detail::encode_rows(value, concurrency);
+
+        auto size = 0ul;
+        for (const auto& buffer : buffers) {
+            size += buffer.size();
+        }
+
+        auto out = std::string{};
+        out.reserve(size);
+        for (const auto& buffer : buffers) {
+            out += buffer;
+        }
+        return out;
+    }
+
+    void save(const std::string& path, const octave_value& value, std::size_t concurrency)
+    {
+        // encoded before the file is opened, so an unsupported value doesn't truncate the file
+        auto buffers = detail::encode_rows(value, concurrency);
+
+        auto flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+        auto file  = detail::OutputFile{ ::open(path.c_str(), flags, 0644) };
+        if (file.m_fd < 0) {
+            detail::throw_write_errno("open");
+        }
+
+        detail::write_buffers(file.m_fd, buffers);
+
+        auto fd = std::exchange(file.m_fd, -1);
+        if (::close(fd) < 0) {
+            detail::throw_write_errno("close");
+        }
+    }
+}
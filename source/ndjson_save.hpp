@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+class octave_value;
+
+namespace octave_ndjson
+{
+    /**
+     * @brief Serialize an Octave value into an NDJSON string (multi-threaded).
+     *
+     * @param value The value, each element of a struct array or a cell array is a document, anything else is
+     *              a single document.
+     * @param concurrency Number of threads.
+     *
+     * @return The documents, one per line, each line ends with a newline.
+     *
+     * @throw std::runtime_error if the value contains a type that can't be represented in JSON (e.g. complex
+     *        numbers or function handles).
+     *
+     * The encoding follows `jsonencode`, so `ndjson_load_*` reads the documents back into the same values: a
+     * scalar struct is an object, a vector is a flat array, a matrix is an array of its rows, a char row
+     * vector is a string, and NaN/Inf are null. The rows are split into tasks, each encoded into its own
+     * buffer, and the buffers are concatenated in order at the end.
+     */
+    std::string dump(const octave_value& value, std::size_t concurrency);
+
+    /**
+     * @brief Serialize an Octave value into an NDJSON file (multi-threaded).
+     *
+     * @param path Path to the file, created or truncated.
+     * @param value The value (see `dump`).
+     * @param concurrency Number of threads.
+     *
+     * @throw std::runtime_error if the value can't be represented in JSON, the file is not touched then.
+     * @throw std::system_error if the file can't be written.
+     *
+     * Same as `dump` but the per-task buffers are written with `writev` directly, without concatenating them
+     * first.
+     */
+    void save(const std::string& path, const octave_value& value, std::size_t concurrency);
+}
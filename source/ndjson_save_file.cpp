@@ -0,0 +1,72 @@
+#include "args.hpp"
+#include "ndjson_load.hpp"
+#include "ndjson_save.hpp"
+
+#include <octave/defun-dld.h>
+#include <octave/error.h>
+
+#include <stdexcept>
+#include <system_error>
+
+static constexpr auto usage_string = R"(
+ndjson_save_file(
+    filepath  : string,         % positional
+    value     : any,            % positional
+    [threads  : integer]        % optional property
+)
+)";
+
+static constexpr auto help_string = R"(
+=============================== ndjson_save_file help page ===============================
+signature:
+    ndjson_save_file(
+        filepath  : string,         % positional
+        value     : any,            % positional
+        [threads  : integer]        % optional property
+    )
+
+parameters:
+    > filepath : Path to the file to be written, created or truncated.
+
+    > value : The value to be saved. Each element of a struct array or a cell array is saved
+              as a document, anything else (including a scalar struct) as a single document.
+
+    > threads : Number of threads used to encode the documents. Must be a positive integer.
+                Defaults to half of the available hardware threads.
+
+behavior:
+    Save a value as NDJSON/JSON Lines, one document per line. The values are encoded the
+    same way [jsonencode] does, so [ndjson_load_file] reads the file back into the same
+    value: a scalar struct is an object, a vector is a flat array, a matrix is an array of
+    its rows, a char row vector is a string, and NaN and Inf are null. Numbers are written
+    in their shortest form that reads back to the same value.
+
+    The documents are encoded in parallel, then written with a single system call (or a
+    few for very large outputs). The file is not touched if the value can't be encoded
+    (e.g. complex numbers or function handles).
+
+example:
+    ```
+        octave> x = ndjson_load_file('data.jsonl');
+        octave> % process x...
+        octave> ndjson_save_file('processed.jsonl', x);
+    ```
+==========================================================================================
+)";
+
+namespace ndjson = octave_ndjson;
+
+DEFUN_DLD(ndjson_save_file, args, , usage_string)
+{
+    auto [path, value, threads] = ndjson::args::parse_save(args, ndjson::args::Kind::File, help_string);
+
+    try {
+        ndjson::save(path, args(value), ndjson::concurrency(threads));
+    } catch (const std::system_error& e) {
+        error("Failed to write file '%s': %s", path.c_str(), e.what());
+    } catch (const std::runtime_error& e) {
+        error("Failed to encode the value: %s", e.what());
+    }
+
+    return octave_value_list{};
+}
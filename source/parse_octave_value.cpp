@@ -1,12 +1,27 @@
 #include "parse_octave_value.hpp"
 
+#include "arena.hpp"
+#include "cancel.hpp"
+#include "projection.hpp"
+#include "schema.hpp"
+
 #include <octave/Cell.h>
 #include <octave/error.h>
 #include <octave/oct-map.h>
 #include <octave/ov.h>
 #include <simdjson/dom.h>
+#include <simdjson/ondemand.h>
 
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <memory_resource>
+#include <optional>
 #include <ranges>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 namespace octave_ndjson::detail
 {
@@ -19,44 +34,136 @@ namespace octave_ndjson::detail
 
     octave_value decode_string(std::string_view string)
     {
-        // string might be not null terminated, it needs to be copied somewhere
-        thread_local static std::string stringbuf = "";
+        // copy straight into the char array instead of going through std::string, an empty string is 0x0
+        // to match what octave_value(std::string) would create
+        auto size  = static_cast<long>(string.size());
+        auto chars = charNDArray{ size == 0 ? dim_vector{ 0, 0 } : dim_vector{ 1, size } };
 
-        stringbuf = string;
-        return stringbuf;
+        std::copy(string.begin(), string.end(), chars.fortran_vec());
+        return octave_value{ chars, '\'' };
     }
 
-    octave_value decode_numeric_array(simdjson::dom::array array)
+    /**
+     * @brief Get the fields of a dom object, reusing the fields of the previous object at the same depth
+     * if the keys are the same.
+     *
+     * @param object The dom object.
+     * @param depth The nesting depth of the object.
+     *
+     * @return The fields in the order of the keys or null if the object has duplicate keys.
+     *
+     * Documents (and arrays of objects) usually repeat the same keys over and over, reusing the fields
+     * means the keys are not copied into a new map for each object. The fields are reference counted, the
+     * returned value is only valid until the next call on the same thread.
+     */
+    const octave_fields* object_fields(simdjson::dom::object object, std::size_t depth)
     {
-        auto ndarray = NDArray{ dim_vector(static_cast<long>(array.size()), 1) };
-        for (auto index = 0; auto elem : array) {
-            ndarray(index++) = elem.is_null() ? octave_NaN : decode(elem).double_value();
+        struct Entry
+        {
+            std::vector<std::string> m_keys;
+            octave_fields            m_fields;
+            bool                     m_unique;
+        };
+
+        thread_local auto cache = std::vector<Entry>{};
+
+        if (depth >= cache.size()) {
+            cache.resize(depth + 1);
+        }
+
+        auto& entry = cache[depth];
+        auto  same  = object.size() == entry.m_keys.size();
+
+        for (auto index = 0ul; auto [key, _] : object) {
+            if (not same) {
+                break;
+            }
+            same = entry.m_keys[index++] == key;
         }
+
+        if (not same) {
+            entry.m_keys.clear();
+            for (auto [key, _] : object) {
+                entry.m_keys.emplace_back(key);
+            }
+
+            auto names     = string_vector{ entry.m_keys };
+            entry.m_fields = octave_fields{ names };
+            entry.m_unique = entry.m_fields.nfields() == static_cast<long>(entry.m_keys.size());
+        }
+
+        return entry.m_unique ? &entry.m_fields : nullptr;
+    }
+
+    std::size_t array_size(simdjson::dom::array array)
+    {
+        static constexpr auto saturated = 0xFFFFFFul;
+
+        auto size = array.size();
+        if (size == saturated) {
+            size = static_cast<std::size_t>(std::ranges::distance(array));
+        }
+        return size;
+    }
+
+    /**
+     * @brief Decode an array as a numeric array (null as NaN) in a single pass over the tape.
+     *
+     * @return The array, or nullopt if a non-numeric element is found.
+     */
+    std::optional<NDArray> decode_numeric_array(simdjson::dom::array array, std::size_t size)
+    {
+        using T = simdjson::dom::element_type;
+
+        auto ndarray = NDArray{ dim_vector(static_cast<long>(size), 1) };
+        auto data    = ndarray.fortran_vec();
+
+        // the values are read right off the tape, without creating an octave_value for each element
+        for (auto elem : array) {
+            switch (elem.type()) {
+            case T::INT64: *data++ = static_cast<double>(elem.get_int64().value_unsafe()); break;
+            case T::UINT64: *data++ = static_cast<double>(elem.get_uint64().value_unsafe()); break;
+            case T::DOUBLE: *data++ = elem.get_double().value_unsafe(); break;
+            case T::NULL_VALUE: *data++ = octave_NaN; break;
+            default: return std::nullopt;
+            }
+        }
+
         return ndarray;
     }
 
     octave_value decode_string_and_mixed_array(simdjson::dom::array array)
     {
-        auto cell = Cell{ dim_vector(static_cast<long>(array.size()), 1) };
+        auto cell = Cell{ dim_vector(static_cast<long>(array_size(array)), 1) };
         for (auto index = 0; auto elem : array) {
             cell(index++) = decode(elem);
         }
         return cell;
     }
 
-    octave_value decode_boolean_array(simdjson::dom::array array)
+    /**
+     * @brief Decode an array as a boolean array in a single pass over the tape.
+     *
+     * @return The array, or nullopt if a non-boolean element is found.
+     */
+    std::optional<boolNDArray> decode_boolean_array(simdjson::dom::array array, std::size_t size)
     {
-        auto ndarray = boolNDArray{ dim_vector(static_cast<long>(array.size()), 1) };
-        for (auto index = 0; auto elem : array) {
-            ndarray(index++) = elem.get_bool().value();
+        auto ndarray = boolNDArray{ dim_vector(static_cast<long>(size), 1) };
+        auto data    = ndarray.fortran_vec();
+
+        for (auto elem : array) {
+            auto boolean = elem.get_bool();
+            if (boolean.error()) {
+                return std::nullopt;
+            }
+            *data++ = boolean.value_unsafe();
         }
+
         return ndarray;
     }
 
-    octave_value decode_array_of_arrays(simdjson::dom::array array)
+    octave_value make_array_of_arrays(const Cell& cell)
     {
-        auto cell = decode_string_and_mixed_array(array).cell_value();
-
         // only arrays with sub-arrays of booleans and others as cell arrays
         auto is_bool        = cell(0).is_bool_matrix();
         auto is_struct      = cell(0).isstruct();
@@ -143,9 +250,8 @@ namespace octave_ndjson::detail
         return array_of_array;
     }
 
-    octave_value decode_object_array(simdjson::dom::array array)
+    octave_value make_object_array(const Cell& struct_cell)
     {
-        auto struct_cell = decode_string_and_mixed_array(array).cell_value();
         auto field_names = struct_cell(0).scalar_map_value().fieldnames();
 
         auto same_field_names = true;
@@ -179,34 +285,186 @@ namespace octave_ndjson::detail
         return struct_array;
     }
 
+    /**
+     * @brief The shape of a nested array whose innermost arrays only contain numbers (or null) or only
+     * booleans, and have the same length at each level.
+     */
+    struct Shape
+    {
+        std::pmr::vector<std::size_t> m_dims;    // the length at each level, outermost first
+        std::optional<bool>           m_bool;    // the innermost arrays contain booleans, set on first one
+    };
+
+    /**
+     * @brief Infer the shape of a nested array by walking the tape without decoding anything.
+     *
+     * @param array The (sub)array.
+     * @param depth The level of the array.
+     * @param shape The shape out parameter, built while walking.
+     *
+     * @return False if the nested array is ragged or contains anything other than what `Shape` describes.
+     */
+    bool infer_shape(simdjson::dom::array array, std::size_t depth, Shape& shape)
+    {
+        using T = simdjson::dom::element_type;
+
+        auto size = array_size(array);
+        if (size == 0) {
+            return false;    // empty subarray is decoded as 0x0 which is never stacked
+        }
+
+        // the innermost arrays must all be at the same level, no level can be added after one is found
+        if (depth == shape.m_dims.size() and not shape.m_bool.has_value()) {
+            shape.m_dims.push_back(size);
+        } else if (depth >= shape.m_dims.size() or shape.m_dims[depth] != size) {
+            return false;
+        }
+
+        auto first   = (*array.begin()).type();
+        auto is_leaf = first != T::ARRAY;
+
+        if (is_leaf and depth + 1 != shape.m_dims.size()) {
+            return false;
+        } else if (is_leaf and not shape.m_bool.has_value()) {
+            shape.m_bool = first == T::BOOL;
+        }
+
+        for (auto elem : array) {
+            switch (elem.type()) {
+            case T::ARRAY:
+                if (is_leaf or not infer_shape(elem.get_array().value_unsafe(), depth + 1, shape)) {
+                    return false;
+                }
+                break;
+            case T::INT64:
+            case T::UINT64:
+            case T::DOUBLE:
+            case T::NULL_VALUE:
+                if (not is_leaf or *shape.m_bool) {
+                    return false;
+                }
+                break;
+            case T::BOOL:
+                if (not is_leaf or not *shape.m_bool) {
+                    return false;
+                }
+                break;
+            default: return false;
+            }
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Write the elements of a nested array with known shape directly into a column-major array.
+     *
+     * @param array The (sub)array.
+     * @param data Pointer to the first element of the (sub)array in the output.
+     * @param strides The distance between consecutive elements at each level.
+     * @param depth The level of the array.
+     */
+    template <typename Elem>
+    void write_shaped(
+        simdjson::dom::array         array,
+        Elem*                        data,
+        std::span<const std::size_t> strides,
+        std::size_t                  depth
+    )
+    {
+        using T = simdjson::dom::element_type;
+
+        auto stride = strides[depth];
+
+        for (auto elem : array) {
+            switch (elem.type()) {
+            case T::ARRAY: write_shaped(elem.get_array().value_unsafe(), data, strides, depth + 1); break;
+            case T::INT64: *data = static_cast<Elem>(elem.get_int64().value_unsafe()); break;
+            case T::UINT64: *data = static_cast<Elem>(elem.get_uint64().value_unsafe()); break;
+            case T::DOUBLE: *data = static_cast<Elem>(elem.get_double().value_unsafe()); break;
+            case T::BOOL: *data = static_cast<Elem>(elem.get_bool().value_unsafe()); break;
+            case T::NULL_VALUE: *data = static_cast<Elem>(octave_NaN); break;
+            default: [[unlikely]] std::abort();    // checked by `infer_shape`
+            }
+            data += stride;
+        }
+    }
+
+    octave_value decode_array_of_arrays(simdjson::dom::array array)
+    {
+        // rectangular numeric or boolean nesting is written straight into the final N-D array, the element
+        // at [i0][i1]...[in] goes to (i0, i1, ..., in), same as what `make_array_of_arrays` would produce
+        auto* arena = Arena::current().resource();
+
+        if (auto shape = Shape{ std::pmr::vector<std::size_t>(arena), {} }; infer_shape(array, 0, shape)) {
+            auto dims    = dim_vector{};
+            auto strides = std::pmr::vector<std::size_t>(shape.m_dims.size(), arena);
+            auto stride  = 1ul;
+
+            dims.resize(static_cast<int>(shape.m_dims.size()));
+            for (auto i = 0ul; i < shape.m_dims.size(); ++i) {
+                dims(static_cast<int>(i)) = static_cast<long>(shape.m_dims[i]);
+                strides[i]                = stride;
+                stride                   *= shape.m_dims[i];
+            }
+
+            if (*shape.m_bool) {
+                auto ndarray = boolNDArray{ dims };
+                write_shaped(array, ndarray.fortran_vec(), strides, 0);
+                return ndarray;
+            } else {
+                auto ndarray = NDArray{ dims };
+                write_shaped(array, ndarray.fortran_vec(), strides, 0);
+                return ndarray;
+            }
+        }
+
+        return make_array_of_arrays(decode_string_and_mixed_array(array).cell_value());
+    }
+
+    octave_value decode_object_array(simdjson::dom::array array)
+    {
+        return make_object_array(decode_string_and_mixed_array(array).cell_value());
+    }
+
     octave_value decode_array(simdjson::dom::array array)
     {
         using Type = simdjson::dom::element_type;
 
-        if (array.size() == 0) {
+        CancelScope::poll();
+
+        auto size = array_size(array);
+        if (size == 0) {
             return NDArray{};
         }
 
-        auto same_type  = true;
-        auto is_numeric = true;
-        auto last_type  = array.at(0).value().type();
+        auto last_type = (*array.begin()).type();
 
-        for (auto elem : array) {
-            is_numeric &= elem.is_number() or elem.is_null();
-            same_type  &= elem.type() == last_type;
+        // fast path for homogeneous numeric and boolean arrays: decoded in a single pass, falling back to the
+        // type detection below only if an element of another type is found
+        if (last_type == Type::INT64 or last_type == Type::UINT64 or last_type == Type::DOUBLE
+            or last_type == Type::NULL_VALUE) {
+            if (auto numeric = decode_numeric_array(array, size)) {
+                return *numeric;
+            }
+        } else if (last_type == Type::BOOL) {
+            if (auto boolean = decode_boolean_array(array, size)) {
+                return *boolean;
+            }
         }
 
-        if (is_numeric) {
-            return decode_numeric_array(array);
+        auto same_type = true;
+        for (auto elem : array) {
+            same_type &= elem.type() == last_type;
         }
 
+        // the numeric and boolean arrays are handled above, so a numeric or boolean first element here
+        // means the array is mixed
         if (not same_type or last_type == Type::STRING) {
             return decode_string_and_mixed_array(array);
         }
 
-        if (last_type == Type::BOOL) {
-            return decode_boolean_array(array);
-        } else if (last_type == Type::OBJECT) {
+        if (last_type == Type::OBJECT) {
             return decode_object_array(array);
         } else if (last_type == Type::ARRAY) {
             return decode_array_of_arrays(array);
@@ -217,8 +475,29 @@ namespace octave_ndjson::detail
 
     octave_value decode_object(simdjson::dom::object object)
     {
+        thread_local auto depth = 0ul;
+
+        struct DepthGuard
+        {
+            DepthGuard() { ++depth; }
+            ~DepthGuard() { --depth; }
+        };
+
+        // the fields are copied (reference counted) before decoding the values since the nested objects
+        // use the cache too
+        if (auto fields = object_fields(object, depth)) {
+            auto map   = octave_scalar_map{ *fields };
+            auto guard = DepthGuard{};
+
+            for (auto index = 0l; auto [_, value] : object) {
+                map.contents(index++) = decode(value);
+            }
+            return map;
+        }
+
         auto map       = octave_scalar_map{};
         auto stringbuf = std::string{};
+        auto guard     = DepthGuard{};
 
         for (auto [key, value] : object) {
             stringbuf = key;
@@ -246,10 +525,228 @@ namespace octave_ndjson::detail
 
 }
 
+namespace octave_ndjson::detail::ondemand
+{
+    namespace od = simdjson::ondemand;
+
+    // the On-Demand values can only be read once and in order, so unlike the dom decoder the type of an
+    // array can't be checked before decoding the elements. while the elements are numbers (or null) they
+    // are collected as doubles, the moment another type appears they are converted into octave_value.
+
+    template <typename Value>
+    octave_value decode(Value&& value, Schema* schema);
+
+    octave_value decode_array(od::array array, Schema* schema)
+    {
+        using T = od::json_type;
+
+        auto* arena = Arena::current().resource();
+
+        // both are only needed until the array is decoded, see `Arena`
+        auto numbers    = std::pmr::vector<double>(arena);
+        auto elements   = std::pmr::vector<octave_value>(arena);
+        auto is_numeric = true;
+        auto same_type  = true;
+        auto first_type = T::null;
+
+        CancelScope::poll();
+
+        if (schema != nullptr) {
+            schema->push(Schema::Array::Begin);
+        }
+
+        for (auto index = 0ul; auto elem : array) {
+            auto value = elem.value();
+            auto type  = value.type().value();
+
+            first_type  = index++ == 0 ? type : first_type;
+            same_type  &= type == first_type;
+
+            if (is_numeric and (type == T::number or type == T::null)) {
+                if (type == T::null) {
+                    value.is_null().value();
+                    numbers.push_back(octave_NaN);
+                } else {
+                    numbers.push_back(value.get_double().value());
+                }
+                if (schema != nullptr) {
+                    schema->push(type == T::null ? Schema::Scalar::Null : Schema::Scalar::Number);
+                }
+                continue;
+            }
+
+            if (is_numeric) {
+                // null is the only source of NaN since JSON can't represent NaN
+                for (auto number : numbers) {
+                    elements.push_back(std::isnan(number) ? NDArray{} : octave_value{ number });
+                }
+                is_numeric = false;
+            }
+
+            elements.push_back(decode(value, schema));
+        }
+
+        if (schema != nullptr) {
+            schema->push(Schema::Array::End);
+        }
+
+        if (is_numeric and numbers.empty()) {
+            return NDArray{};
+        }
+
+        if (is_numeric) {
+            auto ndarray = NDArray{ dim_vector(static_cast<long>(numbers.size()), 1) };
+            std::copy(numbers.begin(), numbers.end(), ndarray.fortran_vec());
+            return ndarray;
+        }
+
+        auto cell = Cell{ dim_vector(static_cast<long>(elements.size()), 1) };
+        for (auto index = 0l; auto& elem : elements) {
+            cell(index++) = std::move(elem);
+        }
+
+        if (not same_type or first_type == T::string) {
+            return cell;
+        }
+
+        switch (first_type) {
+        case T::boolean: {
+            auto ndarray = boolNDArray{ cell.dims() };
+            for (auto i : sv::iota(0l, cell.numel())) {
+                ndarray(i) = cell(i).bool_value();
+            }
+            return ndarray;
+        }
+        case T::object: return make_object_array(cell);
+        case T::array: return make_array_of_arrays(cell);
+        default: error("Unidentified type");
+        }
+    }
+
+    octave_value decode_object(od::object object, Schema* schema)
+    {
+        auto map       = octave_scalar_map{};
+        auto stringbuf = std::string{};
+
+        if (schema != nullptr) {
+            schema->push(Schema::Object::Begin);
+        }
+
+        for (auto field : object) {
+            auto key = field.unescaped_key().value();
+
+            if (schema != nullptr) {
+                schema->push(Schema::Key{ key });
+            }
+
+            stringbuf = key;
+            map.assign(stringbuf, decode(field.value().value(), schema));
+        }
+
+        if (schema != nullptr) {
+            schema->push(Schema::Object::End);
+        }
+
+        return map;
+    }
+
+    // Value is either a document or a value, both have the same interface
+    template <typename Value>
+    octave_value decode(Value&& value, Schema* schema)
+    {
+        using T = od::json_type;
+
+        auto push = [&](Schema::Scalar scalar) {
+            if (schema != nullptr) {
+                schema->push(scalar);
+            }
+        };
+
+        switch (value.type().value()) {
+        case T::array: return decode_array(value.get_array().value(), schema);
+        case T::object: return decode_object(value.get_object().value(), schema);
+        case T::number: push(Schema::Scalar::Number); return value.get_double().value();
+        case T::string: push(Schema::Scalar::String); return decode_string(value.get_string().value());
+        case T::boolean: push(Schema::Scalar::Bool); return value.get_bool().value();
+        case T::null: push(Schema::Scalar::Null); value.is_null().value(); return NDArray{};
+        default: [[unlikely]] throw simdjson::simdjson_error{ simdjson::INCORRECT_TYPE };
+        }
+    }
+
+    /**
+     * @brief Decode the selected fields under a node of the projection tree.
+     *
+     * The fields are looked up by key, so the values that are not selected are skipped without being
+     * decoded at all.
+     */
+    void decode_selected(
+        od::object                 object,
+        const Projection&          projection,
+        const Projection::Node&    node,
+        std::span<octave_value>    values,
+        Schema*                    schema
+    )
+    {
+        auto missing = [&](std::size_t field) {
+            return std::runtime_error{ std::format("Missing field '{}'", projection.paths()[field]) };
+        };
+
+        for (const auto& child : node.m_children) {
+            auto value = object.find_field_unordered(child.m_key);
+            if (value.error() == simdjson::NO_SUCH_FIELD) {
+                throw missing(child.m_field);
+            }
+
+            if (child.m_children.empty()) {
+                if (schema != nullptr) {
+                    schema->push(Schema::Key{ projection.paths()[child.m_field] });
+                }
+                values[child.m_field] = decode(value.value(), schema);
+                continue;
+            }
+
+            auto child_object = value.get_object();
+            if (child_object.error() == simdjson::INCORRECT_TYPE) {
+                throw missing(child.m_field);
+            }
+            decode_selected(child_object.value(), projection, child, values, schema);
+        }
+    }
+}
+
 namespace octave_ndjson
 {
     octave_value parse_octave_value(simdjson::dom::element dom)
     {
         return detail::decode(dom);
     }
+
+    octave_value parse_octave_value(
+        simdjson::ondemand::document_reference doc,
+        Schema*                                schema,
+        const Projection*                      projection
+    )
+    {
+        if (projection == nullptr) {
+            return detail::ondemand::decode(doc, schema);
+        }
+
+        auto object = doc.get_object();
+        if (object.error() == simdjson::INCORRECT_TYPE) {
+            throw std::runtime_error{ std::format("Missing field '{}'", projection->paths()[0]) };
+        }
+
+        auto* arena  = Arena::current().resource();
+        auto  values = std::pmr::vector<octave_value>(projection->paths().size(), octave_value{}, arena);
+
+        if (schema != nullptr) {
+            schema->push(Schema::Object::Begin);
+        }
+        detail::ondemand::decode_selected(object.value(), *projection, projection->root(), values, schema);
+        if (schema != nullptr) {
+            schema->push(Schema::Object::End);
+        }
+
+        return projection->nest(values);
+    }
 }
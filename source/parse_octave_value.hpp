@@ -1,8 +1,48 @@
 #pragma once
 
 #include <simdjson/dom/element.h>
+#include <simdjson/ondemand.h>
+
+#include <cstddef>
+#include <string_view>
 
 class octave_value;
+class Cell;
+
+namespace octave_ndjson
+{
+    class Schema;
+    class Projection;
+}
+
+namespace octave_ndjson::detail
+{
+    // these are exposed for decoders that recognize the array type by other means (see DecodePlan)
+
+    /**
+     * @brief Get the number of elements of a dom array.
+     *
+     * The size stored on the tape saturates (at 2^24 - 1), the elements need to be counted if it does.
+     */
+    std::size_t array_size(simdjson::dom::array array);
+
+    /**
+     * @brief Decode a string into an octave_value (char array).
+     */
+    octave_value decode_string(std::string_view string);
+
+    /**
+     * @brief Create an N-D array (or a cell if not possible) from the decoded elements of an array whose
+     * elements are all arrays.
+     */
+    octave_value make_array_of_arrays(const Cell& cell);
+
+    /**
+     * @brief Create a struct array (or a cell if not possible) from the decoded elements of an array whose
+     * elements are all objects.
+     */
+    octave_value make_object_array(const Cell& struct_cell);
+}
 
 namespace octave_ndjson
 {
@@ -14,6 +54,30 @@ namespace octave_ndjson
      * @return A parsed octave_value.
      *
      * @throw simdjson::simdjson_error on parsing error.
+     * @throw Cancelled if the stop flag of the current `CancelScope` is set.
      */
     octave_value parse_octave_value(simdjson::dom::element dom);
+
+    /**
+     * @brief Parse a simdjson On-Demand document into an octave_value.
+     *
+     * @param doc The simdjson On-Demand document.
+     * @param schema If not null, the schema of the document is built into it while decoding.
+     * @param projection If not null, only the selected fields are decoded (see Projection).
+     *
+     * @return A parsed octave_value, identical to what the dom overload would return.
+     *
+     * @throw simdjson::simdjson_error on parsing error.
+     * @throw std::runtime_error if a selected field doesn't exist in the document.
+     * @throw Cancelled if the stop flag of the current `CancelScope` is set.
+     *
+     * The document is decoded in a single forward pass, without building the dom first. The schema (if
+     * requested) is identical to what is built from the dom, with the selected fields treated as an object
+     * with the paths as its keys in the order of the projection tree.
+     */
+    octave_value parse_octave_value(
+        simdjson::ondemand::document_reference doc,
+        Schema*                                schema,
+        const Projection*                      projection
+    );
 }
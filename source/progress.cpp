@@ -0,0 +1,97 @@
+#include "progress.hpp"
+
+#include <octave/pager.h>
+
+#include <array>
+#include <format>
+#include <string>
+
+namespace octave_ndjson::detail
+{
+    std::string format_size(double bytes)
+    {
+        static constexpr auto units = std::array{ "B", "KiB", "MiB", "GiB", "TiB" };
+
+        auto unit = 0ul;
+        while (bytes >= 1024.0 and unit + 1 < units.size()) {
+            bytes /= 1024.0;
+            ++unit;
+        }
+        return std::format("{:.1f} {}", bytes, units[unit]);
+    }
+
+    void print(
+        std::size_t bytes,
+        std::size_t docs,
+        std::size_t total,
+        double      bytes_per_sec,
+        double      docs_per_sec,
+        const char* end
+    )
+    {
+        auto percent = total != 0 ? 100.0 * static_cast<double>(bytes) / static_cast<double>(total) : 100.0;
+
+        // the trailing spaces clear what's left of a longer previous line
+        octave_stdout << std::format(
+            "\rndjson: {} of {} ({:.0f}%), {} documents, {}/s, {:.0f} documents/s    {}",
+            format_size(static_cast<double>(bytes)),
+            format_size(static_cast<double>(total)),
+            percent,
+            docs,
+            format_size(bytes_per_sec),
+            docs_per_sec,
+            end
+        );
+        octave::flush_stdout();
+    }
+}
+
+namespace octave_ndjson
+{
+    Progress::Progress(std::size_t total) noexcept
+        : m_total{ total }
+        , m_start{ Clock::now() }
+        , m_last{ m_start }
+    {
+    }
+
+    void Progress::report()
+    {
+        auto now = Clock::now();
+        if (now - m_last < interval) {
+            return;
+        }
+
+        auto bytes   = m_bytes.load(std::memory_order_relaxed);
+        auto docs    = m_docs.load(std::memory_order_relaxed);
+        auto elapsed = std::chrono::duration<double>(now - m_last).count();
+
+        auto bytes_per_sec = static_cast<double>(bytes - m_last_bytes) / elapsed;
+        auto docs_per_sec  = static_cast<double>(docs - m_last_docs) / elapsed;
+
+        detail::print(bytes, docs, m_total, bytes_per_sec, docs_per_sec, "");
+
+        m_last       = now;
+        m_last_bytes = bytes;
+        m_last_docs  = docs;
+        m_printed    = true;
+    }
+
+    void Progress::finish()
+    {
+        // a load that finishes within the first interval is not worth a line
+        if (not m_printed) {
+            return;
+        }
+
+        auto bytes   = m_bytes.load(std::memory_order_relaxed);
+        auto docs    = m_docs.load(std::memory_order_relaxed);
+        auto elapsed = std::chrono::duration<double>(Clock::now() - m_start).count();
+
+        auto bytes_per_sec = static_cast<double>(bytes) / elapsed;
+        auto docs_per_sec  = static_cast<double>(docs) / elapsed;
+
+        detail::print(bytes, docs, m_total, bytes_per_sec, docs_per_sec, "\n");
+        m_printed = false;
+    }
+}
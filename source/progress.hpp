@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+
+namespace octave_ndjson
+{
+    /**
+     * @class Progress
+     *
+     * @brief Throughput of a load, counted by the threads parsing the input and printed by the main thread.
+     *
+     * The workers only add to relaxed atomic counters, once per chunk, so counting costs nothing noticeable.
+     * The main thread prints the counters while it waits for the workers (at most once per `interval`) on a
+     * single line that is overwritten each time.
+     */
+    class Progress
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        static constexpr auto interval = std::chrono::seconds{ 1 };
+
+        // number of documents between two updates of a single-threaded load
+        static constexpr auto stride = 4096ul;
+
+        /**
+         * @brief Start counting.
+         *
+         * @param total Size of the input in bytes.
+         */
+        explicit Progress(std::size_t total) noexcept;
+
+        Progress(const Progress&)            = delete;
+        Progress& operator=(const Progress&) = delete;
+
+        /**
+         * @brief Count bytes and documents as processed, can be called from any thread.
+         */
+        void add(std::size_t bytes, std::size_t docs) noexcept
+        {
+            m_bytes.fetch_add(bytes, std::memory_order_relaxed);
+            m_docs.fetch_add(docs, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Set the total of processed bytes and documents (single-threaded load).
+         */
+        void update(std::size_t bytes, std::size_t docs) noexcept
+        {
+            m_bytes.store(bytes, std::memory_order_relaxed);
+            m_docs.store(docs, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Print the progress if `interval` elapsed since the last time, main thread only.
+         *
+         * The rates are those since the last print, so a slowdown shows up right away.
+         */
+        void report();
+
+        /**
+         * @brief Print the average rates of the whole load and end the line, main thread only.
+         *
+         * Nothing is printed if `report` never printed, a short load stays silent.
+         */
+        void finish();
+
+    private:
+        std::atomic<std::size_t> m_bytes = 0;
+        std::atomic<std::size_t> m_docs  = 0;
+
+        std::size_t       m_total;
+        Clock::time_point m_start;
+        Clock::time_point m_last;
+        std::size_t       m_last_bytes = 0;
+        std::size_t       m_last_docs  = 0;
+        bool              m_printed    = false;
+    };
+}
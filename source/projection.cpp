@@ -0,0 +1,89 @@
+#include "projection.hpp"
+
+#include <octave/oct-map.h>
+#include <octave/ov.h>
+#include <simdjson.h>
+
+#include <algorithm>
+#include <format>
+#include <stdexcept>
+
+namespace octave_ndjson
+{
+    Projection::Projection(std::vector<std::string> paths)
+        : m_paths{ std::move(paths) }
+        , m_root{ "", {}, 0 }
+    {
+        if (m_paths.empty()) {
+            throw std::invalid_argument{ "At least one field is required" };
+        }
+
+        for (auto field = 0ul; field < m_paths.size(); ++field) {
+            const auto& path = m_paths[field];
+            auto&       keys = m_keys.emplace_back();
+
+            for (auto begin = 0ul; begin <= path.size();) {
+                auto end = std::min(path.find('.', begin), path.size());
+                if (end == begin) {
+                    throw std::invalid_argument{ std::format("Invalid field '{}'", path) };
+                }
+                keys.emplace_back(path.substr(begin, end - begin));
+                begin = end + 1;
+            }
+
+            auto* node = &m_root;
+            for (const auto& key : keys) {
+                auto found = std::ranges::find(node->m_children, key, &Node::m_key);
+                if (found == node->m_children.end()) {
+                    node = &node->m_children.emplace_back(key, std::vector<Node>{}, field);
+                } else if (&key == &keys.back() or found->m_children.empty()) {
+                    // either the same field or one of them is the parent of the other
+                    throw std::invalid_argument{ std::format("Field '{}' overlaps another field", path) };
+                } else {
+                    node = &*found;
+                }
+            }
+        }
+    }
+
+    void Projection::select(simdjson::dom::element elem, std::vector<Field>& fields) const
+    {
+        fields.clear();
+
+        for (auto field = 0ul; field < m_paths.size(); ++field) {
+            auto value = elem;
+            for (const auto& key : m_keys[field]) {
+                auto next = value.get_object().at_key(key);
+                if (next.error()) {
+                    throw std::runtime_error{ std::format("Missing field '{}'", m_paths[field]) };
+                }
+                value = next.value_unsafe();
+            }
+            fields.emplace_back(m_paths[field], value);
+        }
+    }
+
+    octave_scalar_map Projection::nest(std::span<const octave_value> values) const
+    {
+        return nest(m_root, [&](std::size_t field) { return values[field]; });
+    }
+
+    octave_scalar_map Projection::nest(const octave_scalar_map& flat) const
+    {
+        return nest(m_root, [&](std::size_t field) { return flat.getfield(m_paths[field]); });
+    }
+
+    template <typename Get>
+    octave_scalar_map Projection::nest(const Node& node, Get&& get) const
+    {
+        auto map = octave_scalar_map{};
+        for (const auto& child : node.m_children) {
+            if (child.m_children.empty()) {
+                map.assign(child.m_key, get(child.m_field));
+            } else {
+                map.assign(child.m_key, nest(child, get));
+            }
+        }
+        return map;
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <simdjson/dom/element.h>
+
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class octave_value;
+class octave_scalar_map;
+
+namespace octave_ndjson
+{
+    /**
+     * @class Projection
+     *
+     * @brief Selection of fields to be decoded from each document.
+     *
+     * A field is specified by its path, the keys from the root joined by a dot (e.g. `b.c` selects the key
+     * `c` of the object at key `b`). Only the selected values are decoded and compared, the rest of the
+     * document is ignored. The selected values are presented as a flat object, with the paths as the keys
+     * in the order of the selection, so the schema comparison and the decoders treat it like any other
+     * object. The nesting is restored at the end by `nest`.
+     */
+    class Projection
+    {
+    public:
+        struct Field
+        {
+            std::string_view       m_key;    // the path
+            simdjson::dom::element m_value;
+        };
+
+        // the paths as a tree of keys, in the order of first occurrence
+        struct Node
+        {
+            std::string       m_key;
+            std::vector<Node> m_children;    // empty for a selected field
+            std::size_t       m_field;       // index of the (first) selected field under this node
+        };
+
+        /**
+         * @brief Create a projection from a list of paths.
+         *
+         * @param paths The paths of the fields to be selected.
+         *
+         * @throw std::invalid_argument if a path is empty, is malformed, or overlaps with another path.
+         */
+        explicit Projection(std::vector<std::string> paths);
+
+        /**
+         * @brief Select the fields from a document.
+         *
+         * @param elem The simdjson dom element.
+         * @param fields The selected fields out parameter, in the order of the paths.
+         *
+         * @throw std::runtime_error if a field doesn't exist in the document.
+         */
+        void select(simdjson::dom::element elem, std::vector<Field>& fields) const;
+
+        /**
+         * @brief Create a nested scalar struct from the decoded values of the fields.
+         *
+         * @param values The values in the order of the paths.
+         */
+        octave_scalar_map nest(std::span<const octave_value> values) const;
+
+        /**
+         * @brief Create a nested scalar struct from a scalar struct with the paths as its fields.
+         */
+        octave_scalar_map nest(const octave_scalar_map& flat) const;
+
+        std::span<const std::string> paths() const noexcept { return m_paths; }
+
+        const Node& root() const noexcept { return m_root; }
+
+    private:
+        template <typename Get>
+        octave_scalar_map nest(const Node& node, Get&& get) const;
+
+        std::vector<std::string>              m_paths;
+        std::vector<std::vector<std::string>> m_keys;    // the paths split by dot
+        Node                                  m_root;
+    };
+}
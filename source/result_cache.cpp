@@ -0,0 +1,356 @@
+#include "result_cache.hpp"
+
+#include "mapped_file.hpp"
+
+#include <octave/Cell.h>
+#include <octave/int16NDArray.h>
+#include <octave/int32NDArray.h>
+#include <octave/int64NDArray.h>
+#include <octave/int8NDArray.h>
+#include <octave/oct-map.h>
+#include <octave/ov.h>
+#include <octave/uint16NDArray.h>
+#include <octave/uint32NDArray.h>
+#include <octave/uint64NDArray.h>
+#include <octave/uint8NDArray.h>
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+namespace octave_ndjson::detail
+{
+    constexpr auto cache_magic = std::array{ 'N', 'D', 'J', 'S', 'O', 'N', 'C', '1' };
+
+    enum class Tag : std::uint8_t
+    {
+        Double,
+        Single,
+        Int8,
+        Int16,
+        Int32,
+        Int64,
+        UInt8,
+        UInt16,
+        UInt32,
+        UInt64,
+        Bool,
+        Char,
+        Cell,
+        Struct,
+    };
+
+    /**
+     * @brief Thrown when the cache is truncated or contains an unknown tag.
+     */
+    struct Malformed
+    {
+    };
+
+    class Writer
+    {
+    public:
+        explicit Writer(std::ostream& out)
+            : m_out{ out }
+        {
+        }
+
+        template <typename T>
+        void write(const T& value)
+        {
+            m_out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+        void write_bytes(const void* data, std::size_t size)
+        {
+            m_out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        }
+
+        void write_string(std::string_view string)
+        {
+            write(static_cast<std::uint64_t>(string.size()));
+            write_bytes(string.data(), string.size());
+        }
+
+        void write_dims(const dim_vector& dims)
+        {
+            write(static_cast<std::uint32_t>(dims.ndims()));
+            for (auto i = 0; i < dims.ndims(); ++i) {
+                write(static_cast<std::int64_t>(dims(i)));
+            }
+        }
+
+        template <typename Array>
+        void write_array(Tag tag, const Array& array)
+        {
+            write(tag);
+            write_dims(array.dims());
+            write_bytes(array.data(), static_cast<std::size_t>(array.numel()) * sizeof(*array.data()));
+        }
+
+        void write_value(const octave_value& value)
+        {
+            // clang-format off
+            if      (value.is_char_matrix())  write_array(Tag::Char, value.char_array_value());
+            else if (value.islogical())       write_array(Tag::Bool, value.bool_array_value());
+            else if (value.is_double_type())  write_array(Tag::Double, value.array_value());
+            else if (value.is_single_type())  write_array(Tag::Single, value.float_array_value());
+            else if (value.is_int8_type())    write_array(Tag::Int8, value.int8_array_value());
+            else if (value.is_int16_type())   write_array(Tag::Int16, value.int16_array_value());
+            else if (value.is_int32_type())   write_array(Tag::Int32, value.int32_array_value());
+            else if (value.is_int64_type())   write_array(Tag::Int64, value.int64_array_value());
+            else if (value.is_uint8_type())   write_array(Tag::UInt8, value.uint8_array_value());
+            else if (value.is_uint16_type())  write_array(Tag::UInt16, value.uint16_array_value());
+            else if (value.is_uint32_type())  write_array(Tag::UInt32, value.uint32_array_value());
+            else if (value.is_uint64_type())  write_array(Tag::UInt64, value.uint64_array_value());
+            else if (value.iscell())          write_cell(value.cell_value());
+            else if (value.isstruct())        write_struct(value.map_value());
+            else                              throw std::runtime_error{ "Unsupported type in result" };
+            // clang-format on
+        }
+
+    private:
+        void write_cell(const Cell& cell)
+        {
+            write(Tag::Cell);
+            write_dims(cell.dims());
+            for (auto i = 0l; i < cell.numel(); ++i) {
+                write_value(cell(i));
+            }
+        }
+
+        void write_struct(const octave_map& map)
+        {
+            auto keys = map.fieldnames();
+
+            write(Tag::Struct);
+            write_dims(map.dims());
+            write(static_cast<std::uint64_t>(keys.numel()));
+
+            for (auto i = 0l; i < keys.numel(); ++i) {
+                write_string(keys(i));
+            }
+            for (auto i = 0l; i < keys.numel(); ++i) {
+                const auto& cell = map.contents(i);
+                for (auto j = 0l; j < cell.numel(); ++j) {
+                    write_value(cell(j));
+                }
+            }
+        }
+
+        std::ostream& m_out;
+    };
+
+    class Reader
+    {
+    public:
+        explicit Reader(std::string_view data)
+            : m_data{ data }
+        {
+        }
+
+        template <typename T>
+        T read()
+        {
+            auto value = T{};
+            std::memcpy(&value, take(sizeof(T)), sizeof(T));
+            return value;
+        }
+
+        std::string_view read_string()
+        {
+            auto size = read<std::uint64_t>();
+            return { take(size), size };
+        }
+
+        // the elements take at least `elem_size` bytes each in the rest of the data. the number of elements
+        // is checked one dimension at a time, so a corrupted dimension can't make it wrap around
+        dim_vector read_dims(std::size_t elem_size)
+        {
+            auto ndims = read<std::uint32_t>();
+            if (ndims < 2) {
+                throw Malformed{};
+            }
+
+            auto dims = dim_vector{};
+            dims.resize(static_cast<int>(ndims));
+            for (auto i = 0; i < static_cast<int>(ndims); ++i) {
+                auto dim = read<std::int64_t>();
+                if (dim < 0) {
+                    throw Malformed{};
+                }
+                dims(i) = static_cast<long>(dim);
+            }
+
+            auto limit = (m_data.size() - m_pos) / elem_size;
+            auto count = 1ul;
+            for (auto i = 0; i < static_cast<int>(ndims); ++i) {
+                auto dim = static_cast<std::size_t>(dims(i));
+                if (dim != 0 and count > limit / dim) {
+                    throw Malformed{};
+                }
+                count *= dim;
+            }
+            return dims;
+        }
+
+        template <typename Array>
+        Array read_array()
+        {
+            using Elem = typename Array::element_type;
+
+            // check the size first, so a corrupted dimension doesn't cause a huge allocation
+            auto dims = read_dims(sizeof(Elem));
+            auto size = static_cast<std::size_t>(dims.numel()) * sizeof(Elem);
+            auto data = take(size);
+
+            auto array = Array{ dims };
+            std::memcpy(array.fortran_vec(), data, size);
+            return array;
+        }
+
+        octave_value read_value()
+        {
+            switch (read<Tag>()) {
+            case Tag::Double: return read_array<NDArray>();
+            case Tag::Single: return read_array<FloatNDArray>();
+            case Tag::Int8: return read_array<int8NDArray>();
+            case Tag::Int16: return read_array<int16NDArray>();
+            case Tag::Int32: return read_array<int32NDArray>();
+            case Tag::Int64: return read_array<int64NDArray>();
+            case Tag::UInt8: return read_array<uint8NDArray>();
+            case Tag::UInt16: return read_array<uint16NDArray>();
+            case Tag::UInt32: return read_array<uint32NDArray>();
+            case Tag::UInt64: return read_array<uint64NDArray>();
+            case Tag::Bool: return read_array<boolNDArray>();
+            case Tag::Char: return octave_value{ read_array<charNDArray>(), '\'' };
+            case Tag::Cell: return read_cell();
+            case Tag::Struct: return read_struct();
+            default: throw Malformed{};
+            }
+        }
+
+        bool at_end() const noexcept { return m_pos == m_data.size(); }
+
+    private:
+        const char* take(std::size_t size)
+        {
+            if (size > m_data.size() - m_pos) {
+                throw Malformed{};
+            }
+
+            auto data  = m_data.data() + m_pos;
+            m_pos     += size;
+            return data;
+        }
+
+        // every element takes at least one byte (its tag)
+        dim_vector read_container_dims() { return read_dims(1); }
+
+        octave_value read_cell()
+        {
+            auto cell = Cell{ read_container_dims() };
+            for (auto i = 0l; i < cell.numel(); ++i) {
+                cell(i) = read_value();
+            }
+            return cell;
+        }
+
+        octave_value read_struct()
+        {
+            auto dims  = read_container_dims();
+            auto count = read<std::uint64_t>();
+            auto keys  = std::vector<std::string>{};
+
+            for (auto i = 0ul; i < count; ++i) {
+                keys.emplace_back(read_string());
+            }
+
+            auto map = octave_map{ dims };
+            for (const auto& key : keys) {
+                auto cell = Cell{ dims };
+                for (auto j = 0l; j < cell.numel(); ++j) {
+                    cell(j) = read_value();
+                }
+                map.setfield(key, cell);
+            }
+            return map;
+        }
+
+        std::string_view m_data;
+        std::size_t      m_pos = 0;
+    };
+}
+
+namespace octave_ndjson
+{
+    std::optional<octave_value> load_result(const std::string& path, FileStamp stamp, std::string_view key)
+    {
+        auto file = std::optional<MappedFile>{};
+        try {
+            file.emplace(path);
+        } catch (const std::system_error&) {
+            return std::nullopt;
+        }
+
+        auto view   = file->view();
+        auto reader = detail::Reader{ { view.data(), view.size() } };
+
+        try {
+            auto magic = reader.read<decltype(detail::cache_magic)>();
+            auto size  = reader.read<std::uint64_t>();
+            auto mtime = reader.read<std::int64_t>();
+
+            if (magic != detail::cache_magic or FileStamp{ size, mtime } != stamp) {
+                return std::nullopt;
+            } else if (reader.read_string() != key) {
+                return std::nullopt;
+            }
+
+            auto value = reader.read_value();
+            if (not reader.at_end()) {
+                return std::nullopt;
+            }
+            return value;
+        } catch (const detail::Malformed&) {
+            return std::nullopt;
+        }
+    }
+
+    void save_result(
+        const std::string&  path,
+        FileStamp           stamp,
+        std::string_view    key,
+        const octave_value& value
+    )
+    {
+        auto temp = path + ".tmp";
+        auto ec   = std::error_code{};
+
+        try {
+            auto file   = std::ofstream{ temp, std::ios::binary | std::ios::trunc };
+            auto writer = detail::Writer{ file };
+
+            writer.write(detail::cache_magic);
+            writer.write(stamp.m_size);
+            writer.write(stamp.m_mtime);
+            writer.write_string(key);
+            writer.write_value(value);
+
+            file.close();
+            if (not file) {
+                throw std::system_error{ std::make_error_code(std::errc::io_error), "write cache" };
+            }
+        } catch (...) {
+            std::filesystem::remove(temp, ec);
+            throw;
+        }
+
+        std::filesystem::rename(temp, path);
+    }
+}
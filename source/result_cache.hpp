@@ -0,0 +1,48 @@
+#pragma once
+
+#include "file_stamp.hpp"
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+class octave_value;
+
+namespace octave_ndjson
+{
+    /**
+     * @brief Load a result saved by `save_result`.
+     *
+     * @param path Path to the cache file.
+     * @param stamp The current stamp of the source file.
+     * @param key The options the result must have been loaded with (see `save_result`).
+     *
+     * @return The result, or `std::nullopt` if the cache doesn't exist, is malformed, is stale, or was saved
+     *         with a different key.
+     *
+     * The cache is memory mapped and the arrays are copied straight into the Octave arrays, so loading it
+     * is bound by the I/O instead of the JSON parsing.
+     */
+    std::optional<octave_value> load_result(const std::string& path, FileStamp stamp, std::string_view key);
+
+    /**
+     * @brief Save a result of the load functions to a cache file.
+     *
+     * @param path Path to the cache file.
+     * @param stamp The stamp of the source file the result was loaded from.
+     * @param key Identifies the options that affect the result, opaque to the cache.
+     * @param value The result.
+     *
+     * @throw std::system_error if the file can't be written.
+     * @throw std::runtime_error if the value contains a type that the load functions never produce.
+     *
+     * The cache is written to a temporary file first then renamed, so a concurrent `load_result` never sees
+     * a partially written cache.
+     */
+    void save_result(
+        const std::string&  path,
+        FileStamp           stamp,
+        std::string_view    key,
+        const octave_value& value
+    );
+}
@@ -8,88 +8,272 @@
 #include <variant>
 #include <vector>
 
+namespace octave_ndjson::detail
+{
+    enum class Tag : char
+    {
+        // values of the Scalar enum
+        Number = 0,
+        String = 1,
+        Bool   = 2,
+        Null   = 3,
+
+        // values of the Object and Array enum with offset
+        ObjectBegin = 4,
+        ObjectEnd   = 5,
+        ArrayBegin  = 6,
+        ArrayEnd    = 7,
+
+        // followed by length in LEB128 and the key bytes
+        Key = 8,
+    };
+
+    /**
+     * @brief Read LEB128 encoded length.
+     *
+     * @param ptr Pointer to the first byte, advanced past the last byte.
+     */
+    std::size_t read_length(const char*& ptr) noexcept
+    {
+        auto length = 0ul;
+        auto shift  = 0u;
+        auto byte   = std::uint8_t{};
+
+        do {
+            byte    = static_cast<std::uint8_t>(*ptr++);
+            length |= static_cast<std::size_t>(byte & 0x7f) << shift;
+            shift  += 7;
+        } while (byte & 0x80);
+
+        return length;
+    }
+
+    /**
+     * @brief Advance the iterator past the current array.
+     *
+     * @param it The iterator, must point to `Array::Begin`. Will point to the matching `Array::End`.
+     * @param end The end iterator.
+     */
+    void skip_array(Schema::Iterator& it, Schema::Iterator end) noexcept
+    {
+        auto obj_count = 0;
+        auto arr_count = 1;
+
+        do {
+            ++it;
+            auto part = *it;
+            if (auto* arr = std::get_if<Schema::Array>(&part)) {
+                switch (*arr) {
+                case Schema::Array::Begin: ++arr_count; break;
+                case Schema::Array::End: --arr_count; break;
+                }
+            } else if (auto* obj = std::get_if<Schema::Object>(&part)) {
+                switch (*obj) {
+                case Schema::Object::Begin: ++obj_count; break;
+                case Schema::Object::End: --obj_count; break;
+                }
+            }
+        } while ((obj_count > 0 or arr_count > 0) and it != end);
+    }
+}
+
 namespace octave_ndjson
 {
-    namespace sv = std::views;
+    using detail::Tag;
+
+    Schema::Part Schema::Iterator::operator*() const noexcept
+    {
+        switch (auto tag = static_cast<Tag>(*m_ptr)) {
+        case Tag::Number:
+        case Tag::String:
+        case Tag::Bool:
+        case Tag::Null: return static_cast<Scalar>(tag);
+        case Tag::ObjectBegin: return Object::Begin;
+        case Tag::ObjectEnd: return Object::End;
+        case Tag::ArrayBegin: return Array::Begin;
+        case Tag::ArrayEnd: return Array::End;
+        case Tag::Key: {
+            auto ptr    = m_ptr + 1;
+            auto length = detail::read_length(ptr);
+            return Key{ { ptr, length } };
+        }
+        default: [[unlikely]] std::abort();
+        }
+    }
+
+    Schema::Iterator& Schema::Iterator::operator++() noexcept
+    {
+        if (static_cast<Tag>(*m_ptr++) == Tag::Key) {
+            auto length  = detail::read_length(m_ptr);
+            m_ptr       += length;
+        }
+        return *this;
+    }
+
+    Schema::Iterator Schema::Iterator::operator++(int) noexcept
+    {
+        auto copy = *this;
+        ++*this;
+        return copy;
+    }
+
+    void Schema::push(Scalar scalar) noexcept
+    {
+        append(static_cast<char>(scalar));
+    }
+
+    void Schema::push(Object object) noexcept
+    {
+        append(static_cast<char>(static_cast<char>(Tag::ObjectBegin) + static_cast<char>(object)));
+    }
+
+    void Schema::push(Array array) noexcept
+    {
+        append(static_cast<char>(static_cast<char>(Tag::ArrayBegin) + static_cast<char>(array)));
+    }
+
+    void Schema::push(Key key) noexcept
+    {
+        append(static_cast<char>(Tag::Key));
+
+        auto length = key.m_key.size();
+        do {
+            auto byte   = static_cast<std::uint8_t>(length & 0x7f);
+            length    >>= 7;
+            append(static_cast<char>(length > 0 ? byte | 0x80 : byte));
+        } while (length > 0);
+
+        for (auto ch : key.m_key) {
+            append(ch);
+        }
+    }
 
     bool Schema::root_is_object() const noexcept
     {
-        return m_parts.front() == Part{ Object::Begin };
+        return not m_bytes.empty() and static_cast<Tag>(m_bytes.front()) == Tag::ObjectBegin;
     }
 
-    bool Schema::is_same(const Schema& other, bool dynamic_array) const noexcept
+    bool Schema::is_same_structure(const Schema& other) const noexcept
     {
-        if (not dynamic_array) {
-            if (m_parts.size() != other.m_parts.size()) {
+        auto i = begin();
+        auto j = other.begin();
+
+        while (i != end() and j != other.end()) {
+            if (*i != *j) {
                 return false;
             }
 
-            for (auto i : sv::iota(0u, m_parts.size())) {
-                if (m_parts[i] != other.m_parts[i]) {
-                    return false;
-                }
+            if (*i == Part{ Array::Begin }) {
+                detail::skip_array(i, end());
             }
 
-            return true;
-        } else {
-            auto i = m_parts.begin();
-            auto j = other.m_parts.begin();
+            if (*j == Part{ Array::Begin }) {
+                detail::skip_array(j, other.end());
+            }
 
-            while (i != m_parts.end() and j != other.m_parts.end()) {
-                if (*i != *j) {
-                    return false;
-                }
+            ++i;
+            ++j;
+        }
 
-                if (*i == Part{ Array::Begin }) {
-                    auto obj_count = 0;
-                    auto arr_count = 1;
-
-                    do {
-                        ++i;
-                        if (auto* arr = std::get_if<Array>(&*i)) {
-                            switch (*arr) {
-                            case Array::Begin: ++arr_count; break;
-                            case Array::End: --arr_count; break;
-                            }
-                        } else if (auto* obj = std::get_if<Object>(&*i)) {
-                            switch (*obj) {
-                            case Object::Begin: ++obj_count; break;
-                            case Object::End: --obj_count; break;
-                            }
-                        }
-                    } while ((obj_count > 0 or arr_count > 0) and i != m_parts.end());
+        if (i != end() or j != other.end()) {
+            return false;
+        }
+
+        return true;
+    }
+
+    std::string Schema::first_difference(const Schema& other, bool dynamic_array) const
+    {
+        struct Frame
+        {
+            bool             m_array;
+            std::size_t      m_count;    // number of elements started so far (array only)
+            std::string_view m_key;      // the last key (object only)
+        };
+
+        auto frames = std::vector<Frame>{};
+
+        auto describe = util::Overload{
+            [](const Scalar& scalar) -> std::string {
+                switch (scalar) {
+                case Scalar::Number: return "<number>";
+                case Scalar::String: return "<string>";
+                case Scalar::Bool: return "<bool>";
+                case Scalar::Null: return "<null>";
+                default: [[unlikely]] std::abort();
                 }
+            },
+            [](const Object& object) -> std::string {
+                return object == Object::Begin ? "an object" : "the end of the object";
+            },
+            [](const Array& array) -> std::string {
+                return array == Array::Begin ? "an array" : "the end of the array";
+            },
+            [](const Key& key) -> std::string { return std::format("the key \"{}\"", key.m_key); },
+        };
 
-                if (*j == Part{ Array::Begin }) {
-                    auto obj_count = 0;
-                    auto arr_count = 1;
-
-                    do {
-                        ++j;
-                        if (auto* arr = std::get_if<Array>(&*j)) {
-                            switch (*arr) {
-                            case Array::Begin: ++arr_count; break;
-                            case Array::End: --arr_count; break;
-                            }
-                        } else if (auto* obj = std::get_if<Object>(&*j)) {
-                            switch (*obj) {
-                            case Object::Begin: ++obj_count; break;
-                            case Object::End: --obj_count; break;
-                            }
-                        }
-                    } while ((obj_count > 0 or arr_count > 0) and j != other.m_parts.end());
+        // path to the position of `part` in the reference (this schema)
+        auto path = [&](const Part& part) {
+            auto buffer  = std::string{};
+            auto between = std::holds_alternative<Key>(part) or part == Part{ Object::End };
+
+            for (auto i = 0ul; i < frames.size(); ++i) {
+                auto top = i + 1 == frames.size();
+                if (frames[i].m_array) {
+                    buffer += std::format("[{}]", top ? frames[i].m_count : frames[i].m_count - 1);
+                } else if (not top or not between) {
+                    buffer += buffer.empty() ? "" : ".";
+                    buffer += frames[i].m_key;
                 }
+            }
 
-                ++i;
-                ++j;
+            return buffer.empty() ? std::string{ "<root>" } : buffer;
+        };
+
+        auto report = [&](const Part& part, std::string expected, std::string found) {
+            return std::format("at '{}', expected {} but found {}", path(part), expected, found);
+        };
+
+        auto i = begin();
+        auto j = other.begin();
+
+        while (i != end() and j != other.end()) {
+            auto part = *i;
+            if (part != *j) {
+                return report(part, std::visit(describe, part), std::visit(describe, *j));
             }
 
-            if (i != m_parts.end() or j != other.m_parts.end()) {
-                return false;
+            auto is_array = part == Part{ Array::Begin };
+            auto is_value = std::holds_alternative<Scalar>(part) or part == Part{ Object::Begin } or is_array;
+
+            if (is_value and not frames.empty() and frames.back().m_array) {
+                ++frames.back().m_count;
             }
 
-            return true;
+            if (part == Part{ Object::Begin }) {
+                frames.push_back({ .m_array = false, .m_count = 0, .m_key = {} });
+            } else if (is_array and dynamic_array) {
+                detail::skip_array(i, end());
+                detail::skip_array(j, other.end());
+            } else if (is_array) {
+                frames.push_back({ .m_array = true, .m_count = 0, .m_key = {} });
+            } else if (part == Part{ Object::End } or part == Part{ Array::End }) {
+                frames.pop_back();
+            } else if (auto* key = std::get_if<Key>(&part); key != nullptr and not frames.empty()) {
+                frames.back().m_key = key->m_key;
+            }
+
+            ++i;
+            ++j;
+        }
+
+        if (i != end()) {
+            return report(*i, std::visit(describe, *i), "the end of the document");
+        } else if (j != other.end()) {
+            return report(*j, "the end of the document", std::visit(describe, *j));
         }
+
+        return {};
     }
 
     std::string Schema::stringify(bool dynamic_array) const
@@ -168,8 +352,8 @@ namespace octave_ndjson
             },
         };
 
-        auto it = m_parts.begin();
-        while (it != m_parts.end()) {
+        auto it = begin();
+        while (it != end()) {
             auto part = *it;
             ++it;
 
@@ -177,13 +361,14 @@ namespace octave_ndjson
                 auto obj_count = 0;
                 auto arr_count = 1;
 
-                while ((obj_count > 0 or arr_count > 0) and it != m_parts.end()) {
-                    if (auto* arr = std::get_if<Array>(&*it)) {
+                while ((obj_count > 0 or arr_count > 0) and it != end()) {
+                    auto current = *it;
+                    if (auto* arr = std::get_if<Array>(&current)) {
                         switch (*arr) {
                         case Array::Begin: ++arr_count; break;
                         case Array::End: --arr_count; break;
                         }
-                    } else if (auto* obj = std::get_if<Object>(&*it)) {
+                    } else if (auto* obj = std::get_if<Object>(&current)) {
                         switch (*obj) {
                         case Object::Begin: ++obj_count; break;
                         case Object::End: --obj_count; break;
@@ -194,7 +379,7 @@ namespace octave_ndjson
 
                 buffer += "[ <any> x N ],\n";
 
-                if (it == m_parts.end()) {
+                if (it == end()) {
                     break;
                 }
                 continue;
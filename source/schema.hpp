@@ -1,8 +1,10 @@
 #pragma once
 
+#include <cstdint>
+#include <iterator>
 #include <string>
+#include <string_view>
 #include <variant>
-#include <vector>
 
 namespace octave_ndjson
 {
@@ -10,24 +12,72 @@ namespace octave_ndjson
      * @class Schema
      *
      * @brief A simple representation of JSON schema.
+     *
+     * The schema is stored as a compact byte stream: each part is encoded as a single tag byte, keys are
+     * followed by their length (LEB128) and their bytes inline. A hash of the stream (FNV-1a) is updated as
+     * the parts are pushed, so comparing two identical schemas in strict mode is just a hash comparison and
+     * a memcmp. Since the buffer is reused on `reset()`, building a schema doesn't allocate after the first
+     * few documents.
      */
     class Schema
     {
     public:
         // clang-format off
-        enum class Scalar { Number, String, Bool, Null };
-        enum class Object { Begin, End };
-        enum class Array  { Begin, End };
-        struct Key        { std::string m_key; bool operator==(const Key&) const = default; };
+        enum class Scalar : std::uint8_t { Number, String, Bool, Null };
+        enum class Object : std::uint8_t { Begin, End };
+        enum class Array  : std::uint8_t { Begin, End };
+        struct Key        { std::string_view m_key; bool operator==(const Key&) const = default; };
         // clang-format on
 
+        // the key of a part points to the internal buffer of the schema it is read from
         using Part = std::variant<Scalar, Object, Array, Key>;
 
-        Schema(std::size_t reserve) noexcept { m_parts.reserve(reserve); }
+        /**
+         * @class Iterator
+         *
+         * @brief Forward iterator that decodes the byte stream into parts.
+         */
+        class Iterator
+        {
+        public:
+            using value_type      = Part;
+            using difference_type = std::ptrdiff_t;
+
+            Iterator() = default;
+
+            explicit Iterator(const char* ptr) noexcept
+                : m_ptr{ ptr }
+            {
+            }
+
+            Part      operator*() const noexcept;
+            Iterator& operator++() noexcept;
+            Iterator  operator++(int) noexcept;
+
+            bool operator==(const Iterator&) const = default;
+
+        private:
+            const char* m_ptr = nullptr;
+        };
+
+        Schema(std::size_t reserve) noexcept { m_bytes.reserve(reserve); }
+
+        void push(Scalar scalar) noexcept;
+        void push(Object object) noexcept;
+        void push(Array array) noexcept;
+        void push(Key key) noexcept;
+
+        std::size_t size() const noexcept { return m_bytes.size(); }
+        std::size_t hash() const noexcept { return m_hash; }
+
+        void reset() noexcept
+        {
+            m_bytes.clear();
+            m_hash = fnv_offset;
+        }
 
-        void        push(Part part) noexcept { m_parts.push_back(part); }
-        std::size_t size() const noexcept { return m_parts.size(); }
-        void        reset() noexcept { m_parts.clear(); }
+        Iterator begin() const noexcept { return Iterator{ m_bytes.data() }; }
+        Iterator end() const noexcept { return Iterator{ m_bytes.data() + m_bytes.size() }; }
 
         /**
          * @brief Check if the root of the document is an object
@@ -47,9 +97,29 @@ namespace octave_ndjson
          * if any of the elements happen to be an array or object, it won't be checked further.
          *
          * The strictest comparison is done when `dynamic_array` is false--all elements must be the same and
-         * in the same order.
+         * in the same order. It's defined here so it's inlined into the loaders, where `dynamic_array` is
+         * a constant and the strict comparison is only the hash and a `memcmp`.
          */
-        bool is_same(const Schema& other, bool dynamic_array) const noexcept;
+        bool is_same(const Schema& other, bool dynamic_array) const noexcept
+        {
+            if (not dynamic_array) {
+                return m_hash == other.m_hash and m_bytes == other.m_bytes;
+            }
+            return is_same_structure(other);
+        }
+
+        /**
+         * @brief Describe where the schema first differs from the other schema.
+         *
+         * @param other The other schema to be compared with.
+         * @param dynamic_array Dynamic array mode flag (see `is_same`).
+         *
+         * @return The path to the first difference (e.g. `a.b[2]`, array indices are 0-based) with what is
+         *         found there on each schema, or an empty string if the schemas are the same.
+         *
+         * Unlike a diff of the stringified schemas, this is a single pass over both schemas.
+         */
+        std::string first_difference(const Schema& other, bool dynamic_array) const;
 
         /**
          * @brief Stringify the schema.
@@ -61,6 +131,23 @@ namespace octave_ndjson
         std::string stringify(bool dynamic_array) const;
 
     private:
-        std::vector<Part> m_parts;
+        /**
+         * @brief Dynamic array comparison of `is_same`.
+         */
+        bool is_same_structure(const Schema& other) const noexcept;
+
+        static constexpr std::size_t fnv_offset = 14'695'981'039'346'656'037ul;
+        static constexpr std::size_t fnv_prime  = 1'099'511'628'211ul;
+
+        void append(char byte) noexcept
+        {
+            m_bytes.push_back(byte);
+            m_hash = (m_hash ^ static_cast<std::uint8_t>(byte)) * fnv_prime;
+        }
+
+        std::string m_bytes;
+        std::size_t m_hash = fnv_offset;
     };
+
+    static_assert(std::forward_iterator<Schema::Iterator>);
 }
@@ -0,0 +1,81 @@
+#include "stats.hpp"
+
+#include "arena.hpp"
+
+#include <octave/oct-map.h>
+#include <octave/ov.h>
+
+#include <algorithm>
+#include <array>
+#include <utility>
+
+namespace octave_ndjson::detail
+{
+    double seconds(Stats::Duration duration)
+    {
+        return std::chrono::duration<double>(duration).count();
+    }
+}
+
+namespace octave_ndjson
+{
+    Stats::Scope::Scope(Counters* counters) noexcept
+        : m_prev{ std::exchange(current_counters(), stats_enabled ? counters : nullptr) }
+        , m_allocations{ Arena::current().allocations() }
+    {
+    }
+
+    Stats::Scope::~Scope()
+    {
+        if (auto* counters = std::exchange(current_counters(), m_prev); counters != nullptr) {
+            counters->m_allocations += Arena::current().allocations() - m_allocations;
+        }
+    }
+
+    octave_value Stats::to_octave() const
+    {
+        auto stats = octave_scalar_map{};
+        stats.assign("enabled", stats_enabled);
+
+        if (not stats_enabled) {
+            return stats;
+        }
+
+        auto wall = octave_scalar_map{};
+        wall.assign("read", detail::seconds(m_wall[static_cast<std::size_t>(Phase::Read)]));
+        wall.assign("split", detail::seconds(m_wall[static_cast<std::size_t>(Phase::Split)]));
+        wall.assign("parse", detail::seconds(m_wall[static_cast<std::size_t>(Phase::Parse)]));
+        wall.assign("assemble", detail::seconds(m_wall[static_cast<std::size_t>(Phase::Assemble)]));
+
+        auto count   = static_cast<long>(m_threads.size());
+        auto threads = octave_map{ dim_vector{ count, 1 } };
+        auto fields  = std::array<Cell, 7>{};
+        fields.fill(Cell{ dim_vector{ count, 1 } });
+
+        for (auto i = 0l; i < count; ++i) {
+            const auto& counters = m_threads[static_cast<std::size_t>(i)];
+
+            auto parse = counters.m_busy - counters.m_decode - counters.m_schema;
+
+            fields[0](i) = detail::seconds(counters.m_busy);
+            fields[1](i) = detail::seconds(std::max(parse, Duration::zero()));
+            fields[2](i) = detail::seconds(counters.m_decode);
+            fields[3](i) = detail::seconds(counters.m_schema);
+            fields[4](i) = static_cast<double>(counters.m_bytes);
+            fields[5](i) = static_cast<double>(counters.m_documents);
+            fields[6](i) = static_cast<double>(counters.m_allocations);
+        }
+
+        threads.assign("busy", fields[0]);
+        threads.assign("parse", fields[1]);
+        threads.assign("decode", fields[2]);
+        threads.assign("schema", fields[3]);
+        threads.assign("bytes", fields[4]);
+        threads.assign("documents", fields[5]);
+        threads.assign("allocations", fields[6]);
+
+        stats.assign("wall", wall);
+        stats.assign("threads", threads);
+        return stats;
+    }
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+class octave_value;
+
+namespace octave_ndjson
+{
+    /**
+     * @brief Whether the stats are compiled in (`NDJSON_HAS_STATS`), the timers do nothing otherwise.
+     */
+#ifdef NDJSON_HAS_STATS
+    inline constexpr auto stats_enabled = true;
+#else
+    inline constexpr auto stats_enabled = false;
+#endif
+
+    /**
+     * @class Stats
+     *
+     * @brief Timings and counters of a load, the second output of the load functions.
+     *
+     * The wall time of each phase is measured on the main thread. The workers each have their own counters
+     * (only written by their thread, so there is no synchronization), which their `Scope` makes current for
+     * the decoders running on that thread. A timer is two `steady_clock::now()` calls and is skipped on a
+     * null sink, so a load without stats only pays for a branch on each timer and nothing at all if the
+     * stats are compiled out.
+     */
+    class Stats
+    {
+    public:
+        using Clock    = std::chrono::steady_clock;
+        using Duration = std::chrono::nanoseconds;
+
+        enum class Phase
+        {
+            Read,        // mapping, decompressing, and indexing the file
+            Split,       // cutting the input into chunks and counting the lines of the first window
+            Parse,       // parsing and decoding the documents, the schema comparisons, and counting the
+                         // lines of the next window
+            Assemble,    // building the final value from the decoded documents
+        };
+
+        static constexpr auto num_phases = 4ul;
+
+        /**
+         * @brief Counters of a thread.
+         */
+        struct alignas(64) Counters
+        {
+            Duration    m_busy        = {};    // on the chunks (on the whole input if single-threaded)
+            Duration    m_decode      = {};    // converting the documents into Octave values
+            Duration    m_schema      = {};    // building and comparing the schemas
+            std::size_t m_bytes       = 0;
+            std::size_t m_documents   = 0;
+            std::size_t m_allocations = 0;     // decode temporaries that didn't fit in the arena
+        };
+
+        /**
+         * @class Timer
+         *
+         * @brief Add the lifetime of the timer to a duration.
+         */
+        class Timer
+        {
+        public:
+            explicit Timer(Duration* sink) noexcept
+                : m_sink{ stats_enabled ? sink : nullptr }
+            {
+                if (m_sink != nullptr) {
+                    m_start = Clock::now();
+                }
+            }
+
+            ~Timer() { stop(); }
+
+            Timer(const Timer&)            = delete;
+            Timer& operator=(const Timer&) = delete;
+
+            /**
+             * @brief Stop the timer before the end of its scope.
+             */
+            void stop() noexcept
+            {
+                if (m_sink != nullptr) {
+                    *m_sink += Clock::now() - m_start;
+                    m_sink   = nullptr;
+                }
+            }
+
+        private:
+            Duration*         m_sink;
+            Clock::time_point m_start;
+        };
+
+        /**
+         * @class Scope
+         *
+         * @brief Make the counters of a thread current while the scope is alive (see `CancelScope`).
+         *
+         * The allocations the arena of the thread makes from its upstream during the scope are counted.
+         */
+        class Scope
+        {
+        public:
+            explicit Scope(Counters* counters) noexcept;
+            ~Scope();
+
+            Scope(const Scope&)            = delete;
+            Scope& operator=(const Scope&) = delete;
+
+        private:
+            Counters*   m_prev;
+            std::size_t m_allocations;
+        };
+
+        /**
+         * @brief Get a duration of the counters of the current thread.
+         *
+         * @return The duration, or null if there is no current counters (or the stats are compiled out).
+         */
+        static Duration* current(Duration Counters::* member) noexcept
+        {
+            auto* counters = current_counters();
+            return stats_enabled and counters != nullptr ? &(counters->*member) : nullptr;
+        }
+
+        /**
+         * @brief Set the number of threads, each gets its own counters.
+         */
+        void resize(std::size_t threads) { m_threads.resize(std::max(threads, m_threads.size())); }
+
+        Counters& counters(std::size_t thread) noexcept { return m_threads[thread]; }
+        Duration& wall(Phase phase) noexcept { return m_wall[static_cast<std::size_t>(phase)]; }
+
+        /**
+         * @brief Convert the stats into an Octave struct.
+         *
+         * The struct has the fields `enabled` (false if compiled out, then there is no other field), `wall`
+         * (a struct with the phases in seconds), and `threads` (a struct array with the counters of each
+         * thread, the times in seconds). The `parse` time of a thread is its busy time that is neither
+         * decoding nor schema, mostly parsing.
+         */
+        octave_value to_octave() const;
+
+    private:
+        static Counters*& current_counters() noexcept
+        {
+            thread_local auto counters = static_cast<Counters*>(nullptr);
+            return counters;
+        }
+
+        std::array<Duration, num_phases> m_wall = {};
+        std::vector<Counters>            m_threads;
+    };
+}
@@ -0,0 +1,145 @@
+#include "stream.hpp"
+
+#include <octave/ov.h>
+#include <simdjson.h>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+namespace octave_ndjson
+{
+    Stream::Stream(const std::string& path, const Options& options, bool follow)
+        : m_fd{ ::open(path.c_str(), O_RDONLY | O_CLOEXEC) }
+        , m_options{ options }
+        , m_buffer(chunk_size, '\0')
+        , m_follow{ follow }
+    {
+        if (m_fd < 0) {
+            throw std::system_error{ errno, std::generic_category(), "open" };
+        }
+        ::posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+
+    Stream::~Stream()
+    {
+        ::close(m_fd);
+    }
+
+    octave_value Stream::next(std::size_t count)
+    {
+        m_batch.clear();
+
+        // the file may have grown since the end of file was reached
+        if (m_follow) {
+            m_eof = false;
+        }
+
+        auto lines = 0ul;
+        while (lines < count and next_line()) {
+            ++lines;
+        }
+
+        if (lines == 0) {
+            return NDArray{};
+        }
+
+        m_batch.reserve(m_batch.size() + simdjson::SIMDJSON_PADDING);
+
+        auto view  = simdjson::padded_string_view{ m_batch.data(), m_batch.size(), m_batch.capacity() };
+        auto first = m_reference.m_lines;
+
+        try {
+            return load_multi(view, m_options, m_reference);
+        } catch (...) {
+            // the lines of a failed batch are consumed anyway, the next batch is numbered after them
+            m_reference.m_lines = first + lines;
+            throw;
+        }
+    }
+
+    bool Stream::next_line()
+    {
+        while (true) {
+            auto* begin = m_buffer.data() + m_begin;
+            auto* found = static_cast<char*>(std::memchr(begin, '\n', m_end - m_begin));
+
+            if (found == nullptr and not m_eof) {
+                fill();
+                continue;
+            }
+
+            // the writer may still be in the middle of the last line, keep it until its newline arrives
+            if (found == nullptr and m_follow) {
+                return false;
+            }
+
+            // the last line may not be terminated by a newline
+            auto end = found != nullptr ? static_cast<std::size_t>(found - m_buffer.data()) : m_end;
+            auto len = end - m_begin;
+
+            if (found == nullptr and len == 0) {
+                return false;
+            }
+
+            m_begin = found != nullptr ? end + 1 : end;
+
+            // empty lines are skipped, same as `load_multi`
+            if (len != 0) {
+                m_batch.append(begin, len);
+                m_batch.push_back('\n');
+                return true;
+            }
+        }
+    }
+
+    void Stream::fill()
+    {
+        // move the partial line to the front, grow the buffer if the line is longer than the buffer
+        auto remaining = m_end - m_begin;
+        if (m_begin != 0) {
+            std::memmove(m_buffer.data(), m_buffer.data() + m_begin, remaining);
+        } else if (remaining == m_buffer.size()) {
+            m_buffer.resize(m_buffer.size() * 2);
+        }
+
+        m_begin = 0;
+        m_end   = remaining;
+
+        auto read = ::read(m_fd, m_buffer.data() + m_end, m_buffer.size() - m_end);
+        if (read < 0) {
+            if (errno == EINTR) {
+                return;
+            }
+            throw std::system_error{ errno, std::generic_category(), "read" };
+        }
+
+        if (read == 0 and m_follow and truncated()) {
+            // start over, the partial line is gone with the rest of the old content
+            if (::lseek(m_fd, 0, SEEK_SET) < 0) {
+                throw std::system_error{ errno, std::generic_category(), "lseek" };
+            }
+            m_begin  = 0;
+            m_end    = 0;
+            m_offset = 0;
+            return;
+        }
+
+        m_end    += static_cast<std::size_t>(read);
+        m_offset += static_cast<std::size_t>(read);
+        m_eof     = read == 0;
+    }
+
+    bool Stream::truncated() const
+    {
+        struct stat st = {};
+        if (::fstat(m_fd, &st) < 0) {
+            throw std::system_error{ errno, std::generic_category(), "fstat" };
+        }
+        return static_cast<std::size_t>(st.st_size) < m_offset;
+    }
+}
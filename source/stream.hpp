@@ -0,0 +1,88 @@
+#pragma once
+
+#include "ndjson_load.hpp"
+
+#include <cstddef>
+#include <string>
+
+class octave_value;
+
+namespace octave_ndjson
+{
+    /**
+     * @class Stream
+     *
+     * @brief Reads a JSONL file in batches of documents.
+     *
+     * The file is read in bounded-size chunks, the partial line at the end of a chunk is carried over to
+     * the next one. Only the lines of the current batch are kept in memory, so the memory usage is bounded
+     * by the batch size (and the longest line) instead of the file size. Every batch is checked against the
+     * first document of the file.
+     *
+     * In follow mode the stream is meant for a file that is still being appended to: reaching the end of
+     * file is not final, the next batch continues from the last consumed byte and only reads what has been
+     * appended since. The last line is not consumed until its newline is written, since the writer may
+     * still be in the middle of it. If the file is truncated (e.g. rotated), the stream starts over from the
+     * beginning of the file.
+     */
+    class Stream
+    {
+    public:
+        static constexpr auto chunk_size = 1024ul * 1024;
+
+        /**
+         * @brief Open a file for streaming.
+         *
+         * @param path Path to the file.
+         * @param options Parse options, used for every batch.
+         * @param follow Whether to follow the file as it grows.
+         *
+         * @throw std::system_error if the file can't be opened.
+         */
+        Stream(const std::string& path, const Options& options, bool follow = false);
+
+        ~Stream();
+
+        Stream(Stream&&)            = delete;
+        Stream& operator=(Stream&&) = delete;
+
+        /**
+         * @brief Load the next batch of documents.
+         *
+         * @param count Maximum number of documents in the batch.
+         *
+         * @return The Octave value, same as what `load_multi` would return for the batch, or an empty
+         *         matrix if the end of file is reached (no new complete line in follow mode).
+         *
+         * @throw std::system_error if reading the file failed.
+         * @throw <internal_octave_error> if there is an error parsing the documents.
+         */
+        octave_value next(std::size_t count);
+
+    private:
+        /**
+         * @brief Append the next line to the batch.
+         *
+         * @return False if there is no line left.
+         */
+        bool next_line();
+
+        void fill();
+
+        /**
+         * @brief Check whether the file is now smaller than what has been read from it.
+         */
+        bool truncated() const;
+
+        int         m_fd;
+        Options     m_options;
+        Reference   m_reference;
+        std::string m_buffer;    // the chunk read from the file, [m_begin, m_end) is not consumed yet
+        std::string m_batch;     // the lines of the current batch
+        std::size_t m_begin  = 0;
+        std::size_t m_end    = 0;
+        std::size_t m_offset = 0;    // number of bytes read from the file
+        bool        m_eof    = false;
+        bool        m_follow = false;
+    };
+}
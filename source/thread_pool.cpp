@@ -0,0 +1,99 @@
+#include "thread_pool.hpp"
+
+#include <utility>
+
+namespace octave_ndjson
+{
+    ThreadPool& ThreadPool::instance()
+    {
+        static auto pool = ThreadPool{};
+        return pool;
+    }
+
+    void ThreadPool::run(
+        std::size_t                      concurrency,
+        std::function<void(std::size_t)> fn,
+        std::function<void()>            poll
+    )
+    {
+        if (concurrency == 0) {
+            return;
+        }
+
+        auto run_lock = std::unique_lock{ m_run_mutex };
+        auto lock     = std::unique_lock{ m_mutex };
+
+        while (m_threads.size() < concurrency) {
+            m_threads.emplace_back([this, index = m_threads.size(), generation = m_generation](auto stop) {
+                work(stop, index, generation);
+            });
+        }
+
+        m_fn          = std::move(fn);
+        m_exception   = nullptr;
+        m_concurrency = concurrency;
+        m_remaining   = concurrency;
+        ++m_generation;
+
+        m_start.notify_all();
+
+        auto done           = [&] { return m_remaining == 0; };
+        auto poll_exception = std::exception_ptr{};
+
+        if (poll) {
+            while (not m_finish.wait_for(lock, poll_interval, done)) {
+                if (poll_exception) {
+                    continue;
+                }
+
+                lock.unlock();
+                try {
+                    poll();
+                } catch (...) {
+                    poll_exception = std::current_exception();
+                }
+                lock.lock();
+            }
+        } else {
+            m_finish.wait(lock, done);
+        }
+
+        m_fn = nullptr;
+        if (auto exception = std::exchange(m_exception, nullptr); poll_exception) {
+            std::rethrow_exception(poll_exception);
+        } else if (exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+
+    void ThreadPool::work(std::stop_token stop, std::size_t index, std::size_t generation)
+    {
+        auto lock = std::unique_lock{ m_mutex };
+
+        while (true) {
+            if (not m_start.wait(lock, stop, [&] { return m_generation != generation; })) {
+                return;
+            }
+
+            generation = m_generation;
+            if (index >= m_concurrency) {
+                continue;
+            }
+
+            lock.unlock();
+            try {
+                m_fn(index);
+            } catch (...) {
+                auto guard = std::lock_guard{ m_mutex };
+                if (not m_exception) {
+                    m_exception = std::current_exception();
+                }
+            }
+            lock.lock();
+
+            if (--m_remaining == 0) {
+                m_finish.notify_all();
+            }
+        }
+    }
+}
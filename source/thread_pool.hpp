@@ -0,0 +1,73 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+namespace octave_ndjson
+{
+    /**
+     * @class ThreadPool
+     *
+     * @brief Persistent pool of worker threads.
+     *
+     * The workers are created lazily and survive between calls, so repeated calls to the load functions
+     * don't pay for thread creation. This also means anything `thread_local` in the workers (e.g. the
+     * simdjson parser with its internal buffers already grown) is reused across calls.
+     */
+    class ThreadPool
+    {
+    public:
+        static constexpr auto poll_interval = std::chrono::milliseconds{ 100 };
+
+        /**
+         * @brief Get the process-wide pool.
+         */
+        static ThreadPool& instance();
+
+        /**
+         * @brief Run a function on multiple workers and wait for all of them to finish.
+         *
+         * @param concurrency Number of workers to run the function on, the pool grows if needed.
+         * @param fn The function to run, called with the worker index in `[0, concurrency)`.
+         * @param poll Called on the calling thread every `poll_interval` while it waits, if set.
+         *
+         * @throw The exception thrown by `poll` if any, the first exception thrown by `fn` otherwise,
+         *        rethrown after all workers finished.
+         *
+         * Calls from multiple threads at the same time are serialized. Once `poll` throws it's not called
+         * again, it's up to `poll` to make the workers stop early (e.g. by setting a flag they check). This
+         * is how the interrupts are handled: only the calling thread (the Octave interpreter thread) may
+         * check for them.
+         */
+        void run(
+            std::size_t                      concurrency,
+            std::function<void(std::size_t)> fn,
+            std::function<void()>            poll = {}
+        );
+
+    private:
+        ThreadPool() = default;
+
+        void work(std::stop_token stop, std::size_t index, std::size_t generation);
+
+        std::mutex                  m_run_mutex;
+        std::mutex                  m_mutex;
+        std::condition_variable_any m_start;
+        std::condition_variable     m_finish;
+
+        std::function<void(std::size_t)> m_fn;
+        std::exception_ptr               m_exception;
+        std::size_t                      m_generation  = 0;
+        std::size_t                      m_concurrency = 0;
+        std::size_t                      m_remaining   = 0;
+
+        // must be the last, so the workers are stopped before the rest is destroyed
+        std::vector<std::jthread> m_threads;
+    };
+}
@@ -2,8 +2,13 @@
 
 #include <dtl_modern/dtl_modern.hpp>
 
+#include <algorithm>
+#include <cstring>
 #include <format>
 #include <iostream>
+#include <optional>
+#include <string_view>
+#include <vector>
 
 namespace util
 {
@@ -24,6 +29,9 @@ namespace util
      * @class StringSplitter
      *
      * @brief On-demand string splitter.
+     *
+     * Empty strings between consecutive delimiters are skipped. The delimiter is searched using `memchr`
+     * which is vectorized on most platforms.
      */
     class StringSplitter
     {
@@ -41,27 +49,20 @@ namespace util
          */
         std::optional<std::string_view> next() noexcept
         {
-            if (m_idx >= m_str.size()) {
-                return std::nullopt;
-            }
-
-            while (m_idx <= m_str.size() and m_str[m_idx] == m_delim) {
-                ++m_idx;
-            }
+            while (m_idx < m_str.size()) {
+                auto rest  = m_str.size() - m_idx;
+                auto begin = m_str.data() + m_idx;
+                auto found = static_cast<const char*>(std::memchr(begin, m_delim, rest));
+                auto size  = found != nullptr ? static_cast<std::size_t>(found - begin) : rest;
 
-            auto it = std::ranges::find(m_str | std::views::drop(m_idx), m_delim);
+                m_idx += std::min(size + 1, rest);
 
-            if (it == m_str.end()) {
-                auto res = m_str.substr(m_idx);
-                m_idx    = m_str.size();    // mark end of line
-                return res;
+                if (size > 0) {
+                    return std::string_view{ begin, size };
+                }
             }
 
-            auto pos = static_cast<std::size_t>(it - m_str.begin());
-            auto res = m_str.substr(m_idx, pos - m_idx);
-            m_idx    = pos + 1;
-
-            return res;
+            return std::nullopt;
         }
 
     private:
@@ -103,6 +104,67 @@ namespace util
         return res;
     }
 
+    /**
+     * @brief Count the number of split strings without materializing them.
+     *
+     * @param str The string to be split.
+     * @param delim The delimiter.
+     *
+     * @return The number of strings `StringSplitter` would produce.
+     */
+    inline std::size_t count_split(std::string_view str, char delim) noexcept
+    {
+        auto count = 0ul;
+        auto begin = str.data();
+        auto end   = str.data() + str.size();
+
+        while (begin < end) {
+            auto rest  = static_cast<std::size_t>(end - begin);
+            auto found = static_cast<const char*>(std::memchr(begin, delim, rest));
+            if (found == nullptr) {
+                return count + 1;
+            }
+            count += found != begin;
+            begin  = found + 1;
+        }
+
+        return count;
+    }
+
+    /**
+     * @brief Cut a string into chunks of roughly the same size aligned to a delimiter.
+     *
+     * @param str The string to be cut.
+     * @param count The maximum number of chunks.
+     * @param delim The delimiter.
+     *
+     * @return The chunks, each one ends right after a delimiter (except the last one).
+     *
+     * Splitting each chunk with `StringSplitter` yields exactly the same strings as splitting `str` itself,
+     * so the chunks can be split independently (and concurrently).
+     */
+    inline std::vector<std::string_view> split_chunks(
+        std::string_view str,
+        std::size_t      count,
+        char             delim
+    ) noexcept
+    {
+        auto chunks = std::vector<std::string_view>{};
+        auto size   = std::max((str.size() + count - 1) / std::max(count, 1ul), 1ul);
+        auto begin  = 0ul;
+
+        while (begin < str.size()) {
+            auto pos   = std::min(begin + size, str.size()) - 1;
+            auto found = static_cast<const char*>(std::memchr(str.data() + pos, delim, str.size() - pos));
+            auto end   = found != nullptr ? static_cast<std::size_t>(found - str.data()) + 1 : str.size();
+
+            chunks.push_back(str.substr(begin, end - begin));
+            begin = end;
+        }
+
+        return chunks;
+    }
+
     /**
      * @brief Create a formatted diff string between two strings.
      *